@@ -0,0 +1,30 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+// Common step ABI for benchmarking the models' physics without a display.
+//
+// Each model source, compiled with -DBALLHEX_BENCH, defines bench_model on
+// top of its own update routine. bench/driver.c provides main() and runs
+// every model through the same scenarios.
+
+// Initial ball state in model-independent units: positions are in hexagon
+// radii from the centre, velocities in hexagon radii per step. Each model
+// scales them by its own hexagon radius and step length.
+typedef struct {
+  const char *name;
+  double x, y;
+  double vx, vy;
+} BenchScenario;
+
+typedef struct {
+  const char *name;
+  // Returns the model's state for a fresh scene, or NULL on failure
+  void *(*init)(const BenchScenario *scenario);
+  // Advances the scene by one step; returns the wall contacts in the step
+  int (*step)(void *state);
+  void (*fini)(void *state);
+} BenchModel;
+
+extern const BenchModel bench_model;
+
+#endif
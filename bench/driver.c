@@ -0,0 +1,83 @@
+// Benchmark driver linked into every bin/bench-<model>. Runs the model's
+// step through each scenario and prints one CSV row per scenario:
+//
+//   model,scenario,steps,contacts,ns_per_step,steps_per_sec,contacts_per_sec
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define DEFAULT_STEPS 1000000L
+
+static const BenchScenario scenarios[] = {
+    {"rest", 0.0, 0.0, 0.0, 0.0},        // dropped from the centre
+    {"throw", -0.3, 0.2, 0.02, -0.03},   // thrown up and across
+    {"fast", 0.1, -0.1, 0.025, -0.035},  // several wall hits per second
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-H] [-n steps]\n"
+          "  -H    print the CSV header first\n"
+          "  -n N  steps per scenario (default: %ld)\n",
+          prog, DEFAULT_STEPS);
+}
+
+int main(int argc, char **argv) {
+  long steps = DEFAULT_STEPS;
+  int header = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "Hn:h")) != -1) {
+    switch (opt) {
+    case 'H':
+      header = 1;
+      break;
+    case 'n':
+      steps = atol(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (steps < 1 || optind < argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  if (header)
+    printf("model,scenario,steps,contacts,ns_per_step,steps_per_sec,"
+           "contacts_per_sec\n");
+  for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+    const BenchScenario *scenario = &scenarios[i];
+    void *state = bench_model.init(scenario);
+    if (!state) {
+      fprintf(stderr, "%s: cannot set up scenario %s\n", bench_model.name,
+              scenario->name);
+      return 1;
+    }
+
+    long contacts = 0;
+    double start = now();
+    for (long s = 0; s < steps; s++)
+      contacts += bench_model.step(state);
+    double elapsed = now() - start;
+    bench_model.fini(state);
+
+    printf("%s,%s,%ld,%ld,%.3f,%.0f,%.0f\n", bench_model.name, scenario->name,
+           steps, contacts, elapsed * 1e9 / steps,
+           elapsed > 0 ? steps / elapsed : 0.0,
+           elapsed > 0 ? contacts / elapsed : 0.0);
+  }
+  return 0;
+}
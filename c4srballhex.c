@@ -4,9 +4,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <sys/time.h>
 
+#include "common/drawbatch.h"
+#include "common/framebuffer.h"
+#include "common/eventloop.h"
+#include "common/export.h"
+#include "common/pacer.h"
+#include "common/phases.h"
+#include "common/present.h"
+#include "common/trajectory.h"
+#include "common/triplebuf.h"
+#include "core/hexcore.h"
+
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 600
 #define BALL_RADIUS 15
@@ -15,16 +30,27 @@
 #define FRICTION 0.85
 #define BOUNCE_DAMPING 0.8
 #define ROTATION_SPEED 0.5
+#define FRAME_RATE 60
+#define FIXED_DT 0.016
+#define HEADLESS_DEFAULT_STEPS 1000000L
+#define EXPORT_DEFAULT_STEPS 625L // 10 s of video at FIXED_DT
+#define GRID_CELL_SIZE (2 * BALL_RADIUS)
+#define KEYFRAME_INTERVAL 600 // recorded frames per keyframe index entry
+#define MAX_DT 0.016     // longest frame step without swept collisions
+#define CCD_MAX_DT 0.1   // and with them
+#define STRESS_BALLS 1000
+#define STRESS_SPEED 3000.0 // px/s
+#define STRESS_DURATION 10.0 // simulated seconds
+#define HUD_LINE_HEIGHT 14
 
-typedef struct {
-    double x, y;
-} Point;
+typedef Vec2 Point;
 
 typedef struct {
     Point pos;
     Point vel;
     double radius;
     unsigned long color;
+    unsigned contacts; // TRAJ_*_CONTACT flags of the last step
 } Ball;
 
 typedef struct {
@@ -32,15 +58,29 @@ typedef struct {
     double radius;
     double angle;
     Point vertices[6];
+    HcShape shape;
     unsigned long color;
 } Hexagon;
 
+// Uniform grid used as the broad phase for ball-ball collisions. The world
+// is bounded by the window, so cells are hashed densely as row * cols + col.
+typedef struct {
+    int cols, rows;
+    double cell_size;
+    int *cell_start;   // cols * rows + 1 offsets into cell_balls
+    int *cell_balls;   // ball indices bucketed by cell
+    int *ball_cell;    // cell index of each ball
+    long pair_tests;   // narrow-phase pair tests performed so far
+} Grid;
+
 typedef struct {
     Display *display;
     Window window;
     GC gc;
     int screen;
     unsigned long black, white, red, blue;
+    Presenter present; // core drawing goes to present.target
+    DrawBatch batch;   // used with batch_draw; counts requests either way
 } Graphics;
 
 // Get current time in seconds
@@ -50,42 +90,34 @@ double get_time() {
     return tv.tv_sec + tv.tv_usec / 1000000.0;
 }
 
-// Vector operations
-Point point_add(Point a, Point b) {
-    return (Point){a.x + b.x, a.y + b.y};
-}
-
-Point point_sub(Point a, Point b) {
-    return (Point){a.x - b.x, a.y - b.y};
-}
+// Wall contacts: closest point on each edge, first hit only, reflection
+// scaled by BOUNCE_DAMPING with FRICTION of the tangential part kept. The
+// integrator can be changed with --integrator, and --keep-energy stops the
+// push out of a wall from changing a ball's energy.
+static HcPolicy physics = {
+    .gravity = GRAVITY,
+    .test = HC_TEST_CLOSEST,
+    .push = HC_PUSH_OUT,
+    .response = HC_RESPONSE_SCALE,
+    .restitution = BOUNCE_DAMPING,
+    .tangent_keep = BOUNCE_DAMPING * FRICTION,
+    .first_hit_only = 1
+};
 
-Point point_mul(Point a, double scalar) {
-    return (Point){a.x * scalar, a.y * scalar};
-}
+// Swept (continuous) wall collisions instead of overlap tests after each
+// move, so fast balls cannot tunnel through a wall within one step
+static int use_ccd;
 
-double point_dot(Point a, Point b) {
-    return a.x * b.x + a.y * b.y;
-}
+// Core drawing grouped by colour, one request per colour and shape kind,
+// instead of one foreground change and one request per object
+static int batch_draw;
 
-double point_length(Point a) {
-    return sqrt(a.x * a.x + a.y * a.y);
-}
-
-Point point_normalize(Point a) {
-    double len = point_length(a);
-    if (len == 0) return (Point){0, 0};
-    return (Point){a.x / len, a.y / len};
-}
-
-// Rotate point around origin
-Point rotate_point(Point p, double angle) {
-    double cos_a = cos(angle);
-    double sin_a = sin(angle);
-    return (Point){
-        p.x * cos_a - p.y * sin_a,
-        p.x * sin_a + p.y * cos_a
-    };
-}
+// Where the windowed loop's frame time goes, in loop order
+enum { PHASE_SLEEP, PHASE_EVENTS, PHASE_PHYSICS, PHASE_DRAW, PHASE_PRESENT,
+       PHASE_COUNT };
+static const char *const phase_names[PHASE_COUNT] = {
+    "sleep", "events", "physics", "draw", "present"
+};
 
 // Initialize graphics
 int init_graphics(Graphics *gfx) {
@@ -119,83 +151,30 @@ int init_graphics(Graphics *gfx) {
     XMapWindow(gfx->display, gfx->window);
     
     gfx->gc = XCreateGC(gfx->display, gfx->window, 0, NULL);
+    present_init(&gfx->present, gfx->display, gfx->window);
+    batch_init(&gfx->batch, gfx->display);
     
     return 1;
 }
 
 // Update hexagon vertices based on rotation
 void update_hexagon(Hexagon *hex) {
+    hc_shape_update(&hex->shape, hex->angle);
     for (int i = 0; i < 6; i++) {
-        double vertex_angle = hex->angle + i * M_PI / 3.0;
-        hex->vertices[i].x = hex->center.x + hex->radius * cos(vertex_angle);
-        hex->vertices[i].y = hex->center.y + hex->radius * sin(vertex_angle);
-    }
-}
-
-// Check collision between ball and hexagon wall
-int check_collision(Ball *ball, Hexagon *hex, Point *collision_point, 
-                   Point *normal) {
-    for (int i = 0; i < 6; i++) {
-        Point p1 = hex->vertices[i];
-        Point p2 = hex->vertices[(i + 1) % 6];
-        
-        // Line segment from p1 to p2
-        Point edge = point_sub(p2, p1);
-        Point to_ball = point_sub(ball->pos, p1);
-        
-        // Project ball position onto edge
-        double edge_length_sq = point_dot(edge, edge);
-        if (edge_length_sq == 0) continue;
-        
-        double t = point_dot(to_ball, edge) / edge_length_sq;
-        t = fmax(0.0, fmin(1.0, t)); // Clamp to segment
-        
-        Point closest_point = point_add(p1, point_mul(edge, t));
-        Point to_closest = point_sub(ball->pos, closest_point);
-        double distance = point_length(to_closest);
-        
-        if (distance < ball->radius) {
-            *collision_point = closest_point;
-            *normal = point_normalize(to_closest);
-            return 1;
-        }
+        hex->vertices[i] = (Point){hex->shape.vx[i], hex->shape.vy[i]};
     }
-    return 0;
-}
-
-// Handle ball collision with hexagon wall
-void handle_collision(Ball *ball, Point collision_point, Point normal) {
-    // Move ball out of collision
-    Point correction = point_mul(normal, ball->radius);
-    ball->pos = point_add(collision_point, correction);
-    
-    // Calculate reflection
-    double dot_product = point_dot(ball->vel, normal);
-    Point reflection = point_sub(ball->vel, point_mul(normal, 2.0 * dot_product));
-    
-    // Apply bouncing with damping and friction
-    ball->vel = point_mul(reflection, BOUNCE_DAMPING);
-    
-    // Apply friction (reduce velocity perpendicular to normal)
-    Point tangent = (Point){-normal.y, normal.x};
-    double tangent_velocity = point_dot(ball->vel, tangent);
-    Point friction_force = point_mul(tangent, -tangent_velocity * (1.0 - FRICTION));
-    ball->vel = point_add(ball->vel, friction_force);
 }
 
 // Update ball physics
-void update_ball(Ball *ball, Hexagon *hex, double dt) {
-    // Apply gravity
-    ball->vel.y += GRAVITY * dt;
-    
-    // Update position
-    ball->pos = point_add(ball->pos, point_mul(ball->vel, dt));
-    
-    // Check collision with hexagon
-    Point collision_point, normal;
-    if (check_collision(ball, hex, &collision_point, &normal)) {
-        handle_collision(ball, collision_point, normal);
-    }
+// Returns the number of hexagon walls the ball bounced off
+int update_ball(Ball *ball, Hexagon *hex, double dt) {
+    // Apply gravity, move and bounce off the hexagon
+    HcBall body = {ball->pos.x, ball->pos.y, ball->vel.x, ball->vel.y};
+    int contacts = use_ccd
+        ? hc_sweep(&physics, &hex->shape, &body, ball->radius, dt)
+        : hc_step(&physics, &hex->shape, &body, ball->radius, dt);
+    ball->pos = (Point){body.x, body.y};
+    ball->vel = (Point){body.vx, body.vy};
     
     // Keep ball roughly in window bounds (backup constraint)
     if (ball->pos.x < ball->radius) {
@@ -214,6 +193,7 @@ void update_ball(Ball *ball, Hexagon *hex, double dt) {
         ball->pos.y = WINDOW_HEIGHT - ball->radius;
         ball->vel.y = -ball->vel.y * BOUNCE_DAMPING;
     }
+    return contacts;
 }
 
 // Draw hexagon
@@ -226,13 +206,14 @@ void draw_hexagon(Graphics *gfx, Hexagon *hex) {
     points[6] = points[0]; // Close the polygon
     
     XSetForeground(gfx->display, gfx->gc, hex->color);
-    XDrawLines(gfx->display, gfx->window, gfx->gc, points, 7, CoordModeOrigin);
+    XDrawLines(gfx->display, gfx->present.target, gfx->gc, points, 7,
+               CoordModeOrigin);
 }
 
 // Draw ball
 void draw_ball(Graphics *gfx, Ball *ball) {
     XSetForeground(gfx->display, gfx->gc, ball->color);
-    XFillArc(gfx->display, gfx->window, gfx->gc,
+    XFillArc(gfx->display, gfx->present.target, gfx->gc,
              (int)(ball->pos.x - ball->radius),
              (int)(ball->pos.y - ball->radius),
              (int)(ball->radius * 2),
@@ -240,39 +221,972 @@ void draw_ball(Graphics *gfx, Ball *ball) {
              0, 360 * 64);
 }
 
+// Queue the hexagon's edges and every ball by colour and send them
+void draw_batched(Graphics *gfx, const Ball *balls, int count,
+                  const Hexagon *hex) {
+    for (int i = 0; i < 6; i++) {
+        Point a = hex->vertices[i];
+        Point b = hex->vertices[(i + 1) % 6];
+        batch_segment(&gfx->batch, hex->color, (int)a.x, (int)a.y,
+                      (int)b.x, (int)b.y);
+    }
+    for (int i = 0; i < count; i++) {
+        const Ball *ball = &balls[i];
+        batch_fill_arc(&gfx->batch, ball->color,
+                       (int)(ball->pos.x - ball->radius),
+                       (int)(ball->pos.y - ball->radius),
+                       (unsigned)(ball->radius * 2),
+                       (unsigned)(ball->radius * 2));
+    }
+    batch_flush(&gfx->batch, gfx->present.target, gfx->gc);
+}
+
 // Clear screen
 void clear_screen(Graphics *gfx) {
     XSetForeground(gfx->display, gfx->gc, gfx->white);
-    XFillRectangle(gfx->display, gfx->window, gfx->gc, 
+    XFillRectangle(gfx->display, gfx->present.target, gfx->gc, 
                    0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
 }
 
-int main() {
-    Graphics gfx;
-    if (!init_graphics(&gfx)) {
-        return 1;
+// Rasterize the whole frame client-side
+void rasterize_scene(Framebuffer *fb, uint32_t background, const Ball *balls,
+                     int count, const Hexagon *hex) {
+    fb_clear(fb, background);
+    for (int i = 0; i < 6; i++) {
+        Point a = hex->vertices[i];
+        Point b = hex->vertices[(i + 1) % 6];
+        fb_draw_line(fb, a.x, a.y, b.x, b.y, 1, hex->color);
+    }
+    for (int i = 0; i < count; i++) {
+        fb_fill_circle(fb, balls[i].pos.x, balls[i].pos.y, balls[i].radius,
+                       balls[i].color);
+    }
+}
+
+// Allocate a grid covering the window for up to max_balls balls
+int grid_init(Grid *grid, int max_balls) {
+    grid->cell_size = GRID_CELL_SIZE;
+    grid->cols = (int)ceil(WINDOW_WIDTH / grid->cell_size);
+    grid->rows = (int)ceil(WINDOW_HEIGHT / grid->cell_size);
+    grid->cell_start = calloc(grid->cols * grid->rows + 1, sizeof(int));
+    grid->cell_balls = malloc(max_balls * sizeof(int));
+    grid->ball_cell = malloc(max_balls * sizeof(int));
+    grid->pair_tests = 0;
+    return grid->cell_start && grid->cell_balls && grid->ball_cell;
+}
+
+void grid_free(Grid *grid) {
+    free(grid->cell_start);
+    free(grid->cell_balls);
+    free(grid->ball_cell);
+}
+
+int grid_coord(double v, double cell_size, int limit) {
+    int c = (int)(v / cell_size);
+    if (c < 0) return 0;
+    if (c >= limit) return limit - 1;
+    return c;
+}
+
+// Bucket every ball into its cell with a counting sort
+void grid_build(Grid *grid, Ball *balls, int count) {
+    int cells = grid->cols * grid->rows;
+    for (int c = 0; c <= cells; c++) {
+        grid->cell_start[c] = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        int cx = grid_coord(balls[i].pos.x, grid->cell_size, grid->cols);
+        int cy = grid_coord(balls[i].pos.y, grid->cell_size, grid->rows);
+        grid->ball_cell[i] = cy * grid->cols + cx;
+        grid->cell_start[grid->ball_cell[i] + 1]++;
+    }
+    for (int c = 0; c < cells; c++) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    // cell_start[c] is used as the fill cursor and restored afterwards
+    for (int i = 0; i < count; i++) {
+        grid->cell_balls[grid->cell_start[grid->ball_cell[i]]++] = i;
     }
+    for (int c = cells; c > 0; c--) {
+        grid->cell_start[c] = grid->cell_start[c - 1];
+    }
+    grid->cell_start[0] = 0;
+}
+
+// Resolve an overlapping pair of equal-mass balls
+void handle_ball_collision(Ball *a, Ball *b) {
+    Point delta = vec2_sub(b->pos, a->pos);
+    double distance = vec2_length(delta);
+    double min_distance = a->radius + b->radius;
+    if (distance >= min_distance) return;
+    a->contacts |= TRAJ_BALL_CONTACT;
+    b->contacts |= TRAJ_BALL_CONTACT;
+    
+    // Coincident centers have no defined normal; pick one
+    Point normal = distance > 0 ? vec2_scale(delta, 1.0 / distance)
+                                : (Point){1, 0};
+    
+    // Push the balls apart equally
+    Point correction = vec2_scale(normal, (min_distance - distance) / 2);
+    a->pos = vec2_sub(a->pos, correction);
+    b->pos = vec2_add(b->pos, correction);
     
-    // Initialize ball
-    Ball ball = {
+    // Exchange momentum along the normal if they are approaching
+    double approach = vec2_dot(vec2_sub(a->vel, b->vel), normal);
+    if (approach <= 0) return;
+    Point impulse = vec2_scale(normal, approach * (1.0 + BOUNCE_DAMPING) / 2);
+    a->vel = vec2_sub(a->vel, impulse);
+    b->vel = vec2_add(b->vel, impulse);
+}
+
+// Collide every pair of balls that share a cell or neighbouring cells
+void collide_balls(Ball *balls, int count, Grid *grid) {
+    grid_build(grid, balls, count);
+    
+    for (int i = 0; i < count; i++) {
+        int cx = grid->ball_cell[i] % grid->cols;
+        int cy = grid->ball_cell[i] / grid->cols;
+        
+        for (int y = cy - 1; y <= cy + 1; y++) {
+            if (y < 0 || y >= grid->rows) continue;
+            for (int x = cx - 1; x <= cx + 1; x++) {
+                if (x < 0 || x >= grid->cols) continue;
+                int cell = y * grid->cols + x;
+                for (int k = grid->cell_start[cell];
+                     k < grid->cell_start[cell + 1]; k++) {
+                    int j = grid->cell_balls[k];
+                    // Each pair is visited from both sides; test it once
+                    if (j <= i) continue;
+                    grid->pair_tests++;
+                    handle_ball_collision(&balls[i], &balls[j]);
+                }
+            }
+        }
+    }
+}
+
+// Set up the initial scene shared by the windowed and headless modes. The
+// first ball is the classic one; any others start at random points inside
+// the hexagon with random velocities from a fixed seed. Returns 0 if the
+// hexagon cannot be allocated.
+int init_scene(Ball *balls, int count, Hexagon *hex) {
+    *hex = (Hexagon){
+        .center = {WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2},
+        .radius = HEXAGON_RADIUS,
+        .angle = 0
+    };
+    if (!hc_shape_init(&hex->shape, 6, hex->center, hex->radius,
+                       ROTATION_SPEED)) {
+        return 0;
+    }
+    update_hexagon(hex);
+    
+    balls[0] = (Ball){
         .pos = {WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 - 50},
         .vel = {100, 0},
-        .radius = BALL_RADIUS,
-        .color = gfx.red
+        .radius = BALL_RADIUS
     };
     
-    // Initialize hexagon
-    Hexagon hexagon = {
-        .center = {WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2},
-        .radius = HEXAGON_RADIUS,
-        .angle = 0,
-        .color = gfx.blue
+    double max_r = HEXAGON_RADIUS * cos(M_PI / 6) - BALL_RADIUS;
+    srand(1);
+    for (int i = 1; i < count; i++) {
+        double r = max_r * sqrt(rand() / (double)RAND_MAX);
+        double a = 2 * M_PI * (rand() / (double)RAND_MAX);
+        balls[i] = (Ball){
+            .pos = vec2_add(hex->center, (Point){r * cos(a), r * sin(a)}),
+            .vel = {200.0 * rand() / RAND_MAX - 100, 200.0 * rand() / RAND_MAX - 100},
+            .radius = BALL_RADIUS
+        };
+    }
+    return 1;
+}
+
+// Whether the ball's centre has left the hexagon
+int ball_outside(const Ball *ball, const Hexagon *hex) {
+    const HcShape *shape = &hex->shape;
+    for (int i = 0; i < 6; i++) {
+        double d = (ball->pos.x - shape->vx[i]) * shape->nx[i] +
+                   (ball->pos.y - shape->vy[i]) * shape->ny[i];
+        if (d > 0) return 1;
+    }
+    return 0;
+}
+
+// Put a ball the pair pass has moved back inside the hexagon: out of any
+// wall it now overlaps, or has been pushed through, and no longer moving
+// into it. The wall pass in update_ball() ran before the pair pass moved
+// it, and cannot see a ball whose centre is already past a wall. Returns
+// the number of walls it was pulled back from.
+int confine_ball(Ball *ball, const Hexagon *hex) {
+    const HcShape *shape = &hex->shape;
+    int contacts = 0;
+    // Moving inward along one normal also moves away from every other wall
+    // of the hexagon within reach, so a single pass settles every edge
+    for (int i = 0; i < 6; i++) {
+        Point n = {shape->nx[i], shape->ny[i]};
+        double depth = (ball->pos.x - shape->vx[i]) * n.x +
+                       (ball->pos.y - shape->vy[i]) * n.y + ball->radius;
+        if (depth <= 0) continue;
+        ball->pos = vec2_sub(ball->pos, vec2_scale(n, depth));
+        double out = vec2_dot(ball->vel, n);
+        if (out > 0) {
+            ball->vel = vec2_sub(ball->vel,
+                                 vec2_scale(n, out * (1.0 + BOUNCE_DAMPING)));
+        }
+        contacts++;
+    }
+    return contacts;
+}
+
+// Advance the whole scene by dt
+void step_scene(Ball *balls, int count, Hexagon *hex, Grid *grid, double dt) {
+    hex->angle += ROTATION_SPEED * dt;
+    update_hexagon(hex);
+    
+    for (int i = 0; i < count; i++) {
+        balls[i].contacts = update_ball(&balls[i], hex, dt) ? TRAJ_WALL_CONTACT
+                                                            : 0;
+    }
+    if (count > 1) {
+        collide_balls(balls, count, grid);
+        for (int i = 0; i < count; i++) {
+            if ((balls[i].contacts & TRAJ_BALL_CONTACT) &&
+                confine_ball(&balls[i], hex)) {
+                balls[i].contacts |= TRAJ_WALL_CONTACT;
+            }
+        }
+    }
+}
+
+void print_pair_stats(const Grid *grid, int count, long steps) {
+    if (count < 2 || steps == 0) return;
+    printf("pair tests: %ld\n", grid->pair_tests);
+    printf("pair tests/step: %.1f (brute force: %ld)\n",
+           (double)grid->pair_tests / steps, (long)count * (count - 1) / 2);
+}
+
+// Append the scene to a recording; returns 0 if the file cannot grow
+int record_frame(Trajectory *rec, Ball *balls, int count, Hexagon *hex,
+                 double time) {
+    TrajFrame *frame = traj_append(rec);
+    if (!frame) return 0;
+    frame->time = time;
+    frame->angle = hex->angle;
+    TrajBall *out = traj_balls(frame);
+    for (int i = 0; i < count; i++) {
+        out[i] = (TrajBall){
+            .x = balls[i].pos.x, .y = balls[i].pos.y,
+            .vx = balls[i].vel.x, .vy = balls[i].vel.y,
+            .flags = balls[i].contacts
+        };
+        frame->flags |= balls[i].contacts;
+    }
+    return 1;
+}
+
+// Run the physics flat out with a fixed timestep and no X connection
+int run_headless(Ball *balls, int count, Hexagon *hex, Grid *grid,
+                 long steps, double dt, Trajectory *rec) {
+    long outside = 0; // ball-steps with the centre outside the hexagon
+    double start = get_time();
+    for (long i = 0; i < steps; i++) {
+        step_scene(balls, count, hex, grid, dt);
+        for (int b = 0; b < count; b++) {
+            outside += ball_outside(&balls[b], hex);
+        }
+        if (rec && !record_frame(rec, balls, count, hex, (i + 1) * dt)) {
+            fprintf(stderr, "Recording stopped: %s\n", strerror(errno));
+            rec = NULL;
+        }
+    }
+    double elapsed = get_time() - start;
+    
+    printf("balls: %d\n", count);
+    printf("steps: %ld\n", steps);
+    printf("collisions: %s\n", use_ccd ? "swept" : "discrete");
+    printf("integrator: %s%s\n", hc_integrator_name(physics.integrator),
+           physics.keep_energy ? " (energy kept through push-outs)" : "");
+    printf("dt: %g s\n", dt);
+    printf("simulated time: %.3f s\n", steps * dt);
+    printf("wall time: %.6f s\n", elapsed);
+    printf("steps/sec: %.0f\n", elapsed > 0 ? steps / elapsed : 0.0);
+    print_pair_stats(grid, count, steps);
+    printf("hexagon angle: %.6f\n", hex->angle);
+    printf("ball pos: %.6f %.6f\n", balls[0].pos.x, balls[0].pos.y);
+    printf("ball vel: %.6f %.6f\n", balls[0].vel.x, balls[0].vel.y);
+    printf("outside hexagon: %ld ball-steps\n", outside);
+    if (outside > 0) {
+        fprintf(stderr, "balls left the hexagon\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Draw one frame with whichever renderer is active, without showing it
+void draw_frame(Graphics *gfx, Framebuffer *fb, int software, Ball *balls,
+                int count, Hexagon *hex) {
+    if (software) {
+        rasterize_scene(fb, gfx->white, balls, count, hex);
+    } else if (batch_draw) {
+        clear_screen(gfx);
+        draw_batched(gfx, balls, count, hex);
+    } else {
+        clear_screen(gfx);
+        draw_hexagon(gfx, hex);
+        for (int i = 0; i < count; i++) {
+            draw_ball(gfx, &balls[i]);
+        }
+    }
+}
+
+// Show the frame: one image request in software, a buffer swap otherwise
+void show_frame(Graphics *gfx, Framebuffer *fb, int software) {
+    if (software) {
+        fb_present(fb);
+    } else {
+        present_swap(&gfx->present);
+    }
+    batch_count_frame(&gfx->batch);
+}
+
+void render_scene(Graphics *gfx, Framebuffer *fb, int software, Ball *balls,
+                  int count, Hexagon *hex) {
+    draw_frame(gfx, fb, software, balls, count, hex);
+    show_frame(gfx, fb, software);
+}
+
+// Per-phase p50/p99 in the top left corner. The software renderer replaces
+// the whole window, so there it goes on top after show_frame(); otherwise
+// it is drawn into the frame before the swap.
+void draw_hud(Graphics *gfx, int software, const PhaseTimer *phases) {
+    XSetForeground(gfx->display, gfx->gc, gfx->black);
+    phases_draw(phases, gfx->display,
+                software ? gfx->window : gfx->present.target, gfx->gc, 10,
+                10 + HUD_LINE_HEIGHT, HUD_LINE_HEIGHT);
+}
+
+// --- Threaded mode: physics and rendering on separate threads ---
+
+// What the render thread needs of one physics step. Published through a
+// triple buffer, so the physics thread never waits for the X server and
+// the render thread always draws the newest finished step.
+typedef struct {
+    long step;
+    double time;
+    Point vertices[6];
+    Ball balls[]; // count of them
+} Snapshot;
+
+typedef struct {
+    Ball *balls;
+    int count;
+    Hexagon *hex;
+    Grid *grid;
+    double dt;
+    Trajectory *recording; // NULL once recording stops
+    TripleBuffer snapshots;
+    Pacer pacer;           // physics rate, independent of the frame rate
+    long steps;
+    atomic_int running;
+} Simulation;
+
+void take_snapshot(Snapshot *snap, long step, double dt, const Ball *balls,
+                   int count, const Hexagon *hex) {
+    snap->step = step;
+    snap->time = step * dt;
+    memcpy(snap->vertices, hex->vertices, sizeof(snap->vertices));
+    memcpy(snap->balls, balls, count * sizeof(Ball));
+}
+
+void publish_snapshot(Simulation *sim) {
+    take_snapshot(tb_write_slot(&sim->snapshots), sim->steps, sim->dt,
+                  sim->balls, sim->count, sim->hex);
+    tb_publish(&sim->snapshots);
+}
+
+// Physics thread: fixed steps of sim->dt at 1 / dt steps per second
+void *physics_main(void *arg) {
+    Simulation *sim = arg;
+    while (atomic_load(&sim->running)) {
+        step_scene(sim->balls, sim->count, sim->hex, sim->grid, sim->dt);
+        sim->steps++;
+        if (sim->recording &&
+            !record_frame(sim->recording, sim->balls, sim->count, sim->hex,
+                          sim->steps * sim->dt)) {
+            fprintf(stderr, "Recording stopped: %s\n", strerror(errno));
+            traj_close(sim->recording);
+            sim->recording = NULL;
+        }
+        publish_snapshot(sim);
+        pacer_wait(&sim->pacer);
+    }
+    return NULL;
+}
+
+// Windowed loop with the physics on its own thread at a fixed dt. This
+// thread only handles input and draws the newest snapshot at FRAME_RATE.
+// *recording is cleared if the recording had to be closed early.
+int run_threaded(Graphics *gfx, Framebuffer *fb, int software, Ball *balls,
+                 int count, Hexagon *hex, Grid *grid, double dt,
+                 Trajectory **recording) {
+    Simulation sim = {
+        .balls = balls,
+        .count = count,
+        .hex = hex,
+        .grid = grid,
+        .dt = dt,
+        .recording = *recording,
     };
+    if (!tb_init(&sim.snapshots, sizeof(Snapshot) + count * sizeof(Ball))) {
+        fprintf(stderr, "Cannot allocate snapshots for %d balls\n", count);
+        return 1;
+    }
+    atomic_init(&sim.running, 1);
+    pacer_init(&sim.pacer, 1.0 / dt);
+    publish_snapshot(&sim);
     
+    pthread_t physics;
+    int err = pthread_create(&physics, NULL, physics_main, &sim);
+    if (err) {
+        fprintf(stderr, "pthread_create: %s\n", strerror(err));
+        tb_free(&sim.snapshots);
+        return 1;
+    }
+    
+    // Only the outline and colours are drawn from the hexagon
+    Hexagon view = {.color = hex->color};
+    Pacer pacer;
+    pacer_init(&pacer, FRAME_RATE);
+    EventLoop loop;
+    evloop_init(&loop, gfx->display);
+    long drawn = 0, repeated = 0;
+    int running = 1;
+    
+    while (running) {
+        int frame_due = evloop_wait(&loop, &pacer);
+        while (XPending(gfx->display)) {
+            XEvent event;
+            XNextEvent(gfx->display, &event);
+            if (event.type != KeyPress) continue;
+            KeySym key = XLookupKeysym(&event.xkey, 0);
+            if (key == XK_q || key == XK_Escape) {
+                running = 0;
+            }
+        }
+        if (!running || !frame_due) continue;
+        
+        int fresh;
+        const Snapshot *snap = tb_read(&sim.snapshots, &fresh);
+        if (!fresh) repeated++;
+        memcpy(view.vertices, snap->vertices, sizeof(view.vertices));
+        render_scene(gfx, fb, software, (Ball *)snap->balls, count, &view);
+        drawn++;
+    }
+    
+    atomic_store(&sim.running, 0);
+    pthread_join(physics, NULL);
+    
+    print_pair_stats(grid, count, sim.steps);
+    unsigned long long produced = atomic_load(&sim.snapshots.published);
+    printf("snapshots: %llu produced, %llu drawn, %llu never drawn\n",
+           produced, (unsigned long long)sim.snapshots.consumed,
+           produced - sim.snapshots.consumed);
+    printf("frames: %ld drawn, %ld repeated a snapshot\n", drawn, repeated);
+    printf("physics: %ld steps of %g s, %llu ticks dropped\n", sim.steps, dt,
+           (unsigned long long)sim.pacer.skipped);
+    pacer_report(&pacer, stderr);
+    evloop_report(&loop, stderr);
+    evloop_destroy(&loop);
+    tb_free(&sim.snapshots);
+    *recording = sim.recording;
+    return 0;
+}
+
+// --- Export: frames drawn offscreen and written as video ---
+
+// Colours of an exported frame, as 0xRRGGBB
+typedef struct {
+    int count;
+    uint32_t background, hexagon;
+} ExportStyle;
+
+// Runs on the export workers; draws exactly what the --shm window would
+void export_render(Framebuffer *fb, const void *scene, void *ctx) {
+    const Snapshot *snap = scene;
+    const ExportStyle *style = ctx;
+    Hexagon view = {.color = style->hexagon};
+    memcpy(view.vertices, snap->vertices, sizeof(view.vertices));
+    rasterize_scene(fb, style->background, snap->balls, style->count, &view);
+}
+
+long gcd(long a, long b) {
+    while (b) {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Run the physics flat out like run_headless() and export the initial scene
+// and every step as one video frame, at 1 / dt frames per second
+int run_export(Ball *balls, int count, Hexagon *hex, Grid *grid, long steps,
+               double dt, Trajectory *rec, const char *path, int threads) {
+    ExportStyle style = {count, 0xffffff, 0x0000ff};
+    for (int i = 0; i < count; i++) {
+        balls[i].color = 0xff0000;
+    }
+    
+    // The frame rate as a fraction with microsecond resolution
+    long fps_num = 1000000, fps_den = lround(dt * 1e6);
+    long divisor = gcd(fps_num, fps_den);
+    Exporter vx;
+    if (!vx_open(&vx, path, WINDOW_WIDTH, WINDOW_HEIGHT, fps_num / divisor,
+                 fps_den / divisor, sizeof(Snapshot) + count * sizeof(Ball),
+                 threads, export_render, &style)) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    
+    take_snapshot(vx_frame(&vx), 0, dt, balls, count, hex);
+    vx_submit(&vx);
+    for (long i = 0; i < steps; i++) {
+        step_scene(balls, count, hex, grid, dt);
+        if (rec && !record_frame(rec, balls, count, hex, (i + 1) * dt)) {
+            fprintf(stderr, "Recording stopped: %s\n", strerror(errno));
+            rec = NULL;
+        }
+        take_snapshot(vx_frame(&vx), i + 1, dt, balls, count, hex);
+        vx_submit(&vx);
+    }
+    int ok = vx_close(&vx);
+    if (!ok) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    }
+    
+    vx_report(&vx, stderr);
+    fprintf(stderr, "simulated time: %.3f s\n", steps * dt);
+    return ok ? 0 : 1;
+}
+
+// Load recorded frame i into the scene used for drawing
+void load_frame(Trajectory *rec, uint64_t i, Ball *balls, Hexagon *hex) {
+    TrajFrame *frame = traj_frame(rec, i);
+    TrajBall *in = traj_balls(frame);
+    hex->angle = frame->angle;
+    update_hexagon(hex);
+    for (uint32_t k = 0; k < rec->header->ball_count; k++) {
+        balls[k].pos = (Point){in[k].x, in[k].y};
+        balls[k].vel = (Point){in[k].vx, in[k].vy};
+        balls[k].contacts = in[k].flags;
+    }
+}
+
+// Replay a recording without simulating. Frames are read straight from the
+// mapped file, so seeking anywhere costs the same as the next frame.
+//
+//   space         pause / resume
+//   left, right   step one frame back / forward (pauses)
+//   page up/down  jump 10 seconds back / forward
+//   home, end     first / last frame
+//   0-9           jump to that tenth of the recording
+int run_playback(const char *path, long seek, int headless, int software) {
+    Trajectory rec;
+    if (!traj_open(&rec, path)) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    uint64_t frames = rec.header->frame_count;
+    int count = (int)rec.header->ball_count;
+    if (frames == 0 || count == 0) {
+        fprintf(stderr, "%s: empty recording\n", path);
+        traj_close(&rec);
+        return 1;
+    }
+    uint64_t cur = (uint64_t)seek < frames ? (uint64_t)seek : frames - 1;
+    
+    if (headless) {
+        TrajFrame *frame = traj_frame(&rec, cur);
+        TrajBall *ball = traj_balls(frame);
+        printf("frames: %llu\n", (unsigned long long)frames);
+        printf("frame: %llu\n", (unsigned long long)cur);
+        printf("time: %.6f\n", frame->time);
+        printf("hexagon angle: %.6f\n", frame->angle);
+        printf("ball pos: %.6f %.6f\n", ball->x, ball->y);
+        printf("ball vel: %.6f %.6f\n", ball->vx, ball->vy);
+        printf("contacts: %s%s\n",
+               frame->flags & TRAJ_WALL_CONTACT ? "wall " : "",
+               frame->flags & TRAJ_BALL_CONTACT ? "ball" : "");
+        traj_close(&rec);
+        return 0;
+    }
+    
+    Ball *balls = calloc(count, sizeof(Ball));
+    Hexagon hexagon;
+    Graphics gfx;
+    if (!balls || !init_scene(balls, 1, &hexagon) || !init_graphics(&gfx)) {
+        traj_close(&rec);
+        return 1;
+    }
+    for (int i = 0; i < count; i++) {
+        balls[i].radius = BALL_RADIUS;
+        balls[i].color = gfx.red;
+    }
+    hexagon.color = gfx.blue;
+    
+    Framebuffer fb;
+    if (software && !fb_init(&fb, gfx.display, gfx.window, gfx.gc,
+                             WINDOW_WIDTH, WINDOW_HEIGHT)) {
+        fprintf(stderr, "Software renderer unavailable, using core drawing\n");
+        software = 0;
+    }
+    
+    const TrajFrame *last = traj_frame(&rec, frames - 1);
+    double play_time = traj_frame(&rec, cur)->time;
+    int paused = 0;
+    int running = 1;
+    Pacer pacer;
+    pacer_init(&pacer, FRAME_RATE);
+    EventLoop loop;
+    evloop_init(&loop, gfx.display);
+    
+    while (running) {
+        int frame_due = evloop_wait(&loop, &pacer);
+        while (XPending(gfx.display)) {
+            XEvent event;
+            XNextEvent(gfx.display, &event);
+            if (event.type != KeyPress) continue;
+            
+            KeySym key = XLookupKeysym(&event.xkey, 0);
+            int jump = 1; // seek to target by time
+            double target = play_time;
+            if (key == XK_Prior) {
+                target = play_time - 10;
+            } else if (key == XK_Next) {
+                target = play_time + 10;
+            } else if (key >= XK_0 && key <= XK_9) {
+                target = last->time * (key - XK_0) / 10;
+            } else {
+                jump = 0;
+            }
+            
+            if (jump) {
+                play_time = fmax(0.0, fmin(last->time, target));
+                cur = traj_find_time(&rec, play_time);
+            } else if (key == XK_q || key == XK_Escape) {
+                running = 0;
+            } else if (key == XK_space) {
+                paused = !paused;
+            } else if (key == XK_Left || key == XK_Right) {
+                // Frames are stepped by index, not by time
+                paused = 1;
+                if (key == XK_Left && cur > 0) cur--;
+                if (key == XK_Right && cur + 1 < frames) cur++;
+                play_time = traj_frame(&rec, cur)->time;
+            } else if (key == XK_Home || key == XK_End) {
+                cur = key == XK_Home ? 0 : frames - 1;
+                play_time = traj_frame(&rec, cur)->time;
+            }
+        }
+        if (!running || !frame_due) continue;
+        
+        if (!paused && cur + 1 < frames) {
+            play_time += 1.0 / FRAME_RATE;
+            cur = traj_find_time(&rec, play_time);
+        }
+        load_frame(&rec, cur, balls, &hexagon);
+        render_scene(&gfx, &fb, software, balls, count, &hexagon);
+    }
+    
+    evloop_destroy(&loop);
+    batch_report(&gfx.batch, stderr);
+    if (software) {
+        fb_destroy(&fb);
+    }
+    batch_destroy(&gfx.batch);
+    present_destroy(&gfx.present);
+    XCloseDisplay(gfx.display);
+    hc_shape_free(&hexagon.shape);
+    free(balls);
+    traj_close(&rec);
+    return 0;
+}
+
+// Whether a ball's centre has left the hexagon, i.e. tunneled through a wall
+int ball_escaped(const Hexagon *hex, const Ball *ball) {
+    const HcShape *shape = &hex->shape;
+    double apothem = shape->radius * cos(M_PI / shape->sides);
+    Point rel = vec2_sub(ball->pos, hex->center);
+    for (int i = 0; i < shape->sides; i++) {
+        if (rel.x * shape->nx[i] + rel.y * shape->ny[i] > apothem) return 1;
+    }
+    return 0;
+}
+
+// One stress run: fast balls from a fixed seed, stepped independently (no
+// ball-ball collisions) and checked for escapes after every step. Returns
+// the number of balls that escaped, or -1 if out of memory.
+long stress_run(int ccd, double dt, int count, double *elapsed) {
+    Ball *balls = malloc(count * sizeof(Ball));
+    char *escaped = calloc(count, 1);
+    Hexagon hex;
+    if (!balls || !escaped || !init_scene(balls, count, &hex)) {
+        free(balls);
+        free(escaped);
+        return -1;
+    }
+    srand(2);
+    for (int i = 0; i < count; i++) {
+        double a = 2 * M_PI * (rand() / (double)RAND_MAX);
+        balls[i].vel = (Point){STRESS_SPEED * cos(a), STRESS_SPEED * sin(a)};
+    }
+    
+    use_ccd = ccd;
+    long steps = (long)(STRESS_DURATION / dt + 0.5);
+    long lost = 0;
+    double start = get_time();
+    for (long s = 0; s < steps; s++) {
+        hex.angle += ROTATION_SPEED * dt;
+        update_hexagon(&hex);
+        for (int i = 0; i < count; i++) {
+            update_ball(&balls[i], &hex, dt);
+            if (!escaped[i] && ball_escaped(&hex, &balls[i])) {
+                escaped[i] = 1;
+                lost++;
+            }
+        }
+    }
+    *elapsed = get_time() - start;
+    
+    hc_shape_free(&hex.shape);
+    free(escaped);
+    free(balls);
+    return lost;
+}
+
+// Tunneling stress test. Discrete steps are halved from MAX_DT until no
+// ball escapes; swept steps are tried at MAX_DT and longer. The speedup
+// compares the longest clean swept step with the longest clean discrete
+// one, at the same correctness (no escapes).
+int run_stress(int count) {
+    double clean_discrete = 0, clean_ccd = 0;
+    
+    printf("%d balls at %.0f px/s for %.0f simulated seconds\n", count,
+           STRESS_SPEED, STRESS_DURATION);
+    printf("%-10s %10s %8s %8s %12s\n", "collisions", "dt", "steps",
+           "escaped", "wall time");
+    for (int ccd = 0; ccd <= 1; ccd++) {
+        for (int k = 0; k < 10; k++) {
+            // Discrete: MAX_DT / 2^k; swept: MAX_DT * 2^k up to CCD_MAX_DT
+            double dt = ccd ? MAX_DT * (1 << k) : MAX_DT / (1 << k);
+            if (ccd && dt > CCD_MAX_DT) break;
+            double elapsed;
+            long lost = stress_run(ccd, dt, count, &elapsed);
+            if (lost < 0) {
+                fprintf(stderr, "Cannot allocate %d balls\n", count);
+                return 1;
+            }
+            printf("%-10s %10.6f %8ld %8ld %10.3f s\n",
+                   ccd ? "swept" : "discrete", dt,
+                   (long)(STRESS_DURATION / dt + 0.5), lost, elapsed);
+            if (lost == 0) {
+                double *best = ccd ? &clean_ccd : &clean_discrete;
+                if (elapsed < *best || *best == 0) *best = elapsed;
+                if (!ccd) break;
+            }
+        }
+    }
+    
+    if (clean_discrete > 0 && clean_ccd > 0) {
+        printf("speedup at zero escapes: %.1fx\n", clean_discrete / clean_ccd);
+    } else {
+        printf("speedup at zero escapes: n/a\n");
+    }
+    return 0;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--balls N] [--shm] [--batch-draw] [--ccd] "
+            "[--threaded] [--record FILE] [--phase-csv FILE]\n"
+            "           [--headless [--steps N]] [--dt S] "
+            "[--integrator euler|verlet|rk4] [--keep-energy]\n"
+            "       %s [--balls N] [--ccd] [--record FILE] [--steps N] "
+            "[--dt S] --export FILE [--threads N]\n"
+            "       %s --play FILE [--seek FRAME] [--shm] [--batch-draw] "
+            "[--headless]\n"
+            "       %s --stress [--balls N]\n",
+            prog, prog, prog, prog);
+}
+
+int main(int argc, char **argv) {
+    int headless = 0;
+    int software = 0;
+    long steps = 0;
+    int steps_given = 0;
+    long num_balls = 1;
+    long seek = 0;
+    double fixed_dt = FIXED_DT;
+    int stress = 0;
+    int threaded = 0;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *record_path = NULL;
+    const char *play_path = NULL;
+    const char *export_path = NULL;
+    const char *phase_csv_path = NULL;
+    
+    for (int i = 1; i < argc; i++) {
+        char *end = NULL;
+        if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else if (strcmp(argv[i], "--shm") == 0) {
+            software = 1;
+        } else if (strcmp(argv[i], "--batch-draw") == 0) {
+            batch_draw = 1;
+        } else if (strcmp(argv[i], "--ccd") == 0) {
+            use_ccd = 1;
+        } else if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc) {
+            if (!hc_integrator_parse(argv[++i], &physics.integrator)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--keep-energy") == 0) {
+            physics.keep_energy = 1;
+        } else if (strcmp(argv[i], "--threaded") == 0) {
+            threaded = 1;
+        } else if (strcmp(argv[i], "--stress") == 0) {
+            stress = 1;
+        } else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc) {
+            fixed_dt = strtod(argv[++i], &end);
+        } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+            steps = strtol(argv[++i], &end, 10);
+            steps_given = 1;
+        } else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+            num_balls = strtol(argv[++i], &end, 10);
+        } else if (strcmp(argv[i], "--seek") == 0 && i + 1 < argc) {
+            seek = strtol(argv[++i], &end, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = (int)strtol(argv[++i], &end, 10);
+        } else if (strcmp(argv[i], "--phase-csv") == 0 && i + 1 < argc) {
+            phase_csv_path = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            export_path = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            play_path = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+        if (end && (*end != '\0' || steps < 0 || num_balls < 1 ||
+                    num_balls > 1000000 || seek < 0 || threads < 1 ||
+                    !(fixed_dt > 0) ||
+                    fixed_dt > 1)) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (export_path && !vx_path_ok(export_path)) {
+        fprintf(stderr,
+                "%s: allows one %%d (or %%0Nd) and no %% but %%%%\n",
+                export_path);
+        usage(argv[0]);
+        return 1;
+    }
+    
+    if (!steps_given) {
+        steps = export_path ? EXPORT_DEFAULT_STEPS : HEADLESS_DEFAULT_STEPS;
+    }
+    
+    if (play_path) {
+        return run_playback(play_path, seek, headless, software);
+    }
+    if (stress) {
+        return run_stress(num_balls > 1 ? (int)num_balls : STRESS_BALLS);
+    }
+    
+    int count = (int)num_balls;
+    Ball *balls = malloc(count * sizeof(Ball));
+    Grid grid;
+    Hexagon hexagon;
+    if (!balls || !grid_init(&grid, count) ||
+        !init_scene(balls, count, &hexagon)) {
+        fprintf(stderr, "Cannot allocate %d balls\n", count);
+        return 1;
+    }
+    
+    Trajectory rec;
+    Trajectory *recording = NULL;
+    if (record_path) {
+        if (!traj_create(&rec, record_path, count, KEYFRAME_INTERVAL)) {
+            fprintf(stderr, "%s: %s\n", record_path, strerror(errno));
+            return 1;
+        }
+        recording = &rec;
+        record_frame(recording, balls, count, &hexagon, 0.0);
+    }
+    
+    if (headless || export_path) {
+        int status = export_path
+            ? run_export(balls, count, &hexagon, &grid, steps, fixed_dt,
+                         recording, export_path, threads)
+            : run_headless(balls, count, &hexagon, &grid, steps, fixed_dt,
+                           recording);
+        if (recording && !traj_close(recording)) {
+            fprintf(stderr, "%s: cannot write index\n", record_path);
+        }
+        hc_shape_free(&hexagon.shape);
+        grid_free(&grid);
+        free(balls);
+        return status;
+    }
+    
+    Graphics gfx;
+    if (!init_graphics(&gfx)) {
+        return 1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        balls[i].color = gfx.red;
+    }
+    hexagon.color = gfx.blue;
+    
+    // Optional software renderer; falls back to core drawing if unsupported
+    Framebuffer fb;
+    if (software && !fb_init(&fb, gfx.display, gfx.window, gfx.gc,
+                             WINDOW_WIDTH, WINDOW_HEIGHT)) {
+        fprintf(stderr, "Software renderer unavailable, using core drawing\n");
+        software = 0;
+    }
+    if (software && !fb.use_shm) {
+        fprintf(stderr, "MIT-SHM unavailable, presenting with XPutImage\n");
+    }
+    
+    int status = 0;
+    if (threaded) {
+        status = run_threaded(&gfx, &fb, software, balls, count, &hexagon,
+                              &grid, fixed_dt, &recording);
+        goto done;
+    }
+    
+    Pacer pacer;
+    pacer_init(&pacer, FRAME_RATE);
     double last_time = get_time();
+    double sim_time = 0.0;
+    long frames = 0;
     int running = 1;
+    int show_hud = 0;
+    EventLoop loop;
+    evloop_init(&loop, gfx.display);
+    PhaseTimer phases;
+    phases_init(&phases, phase_names, PHASE_COUNT);
     
     while (running) {
+        // Sleep until input arrives or the next frame is due
+        int frame_due = evloop_wait(&loop, &pacer);
+        phases_lap(&phases, PHASE_SLEEP);
+        
         // Handle events
         while (XPending(gfx.display)) {
             XEvent event;
@@ -283,6 +1197,8 @@ int main() {
                     KeySym key = XLookupKeysym(&event.xkey, 0);
                     if (key == XK_q || key == XK_Escape) {
                         running = 0;
+                    } else if (key == XK_h) {
+                        show_hud = !show_hud;
                     }
                     break;
                 }
@@ -290,31 +1206,109 @@ int main() {
                     break;
             }
         }
+        phases_lap(&phases, PHASE_EVENTS);
+        if (!running || !frame_due) continue;
         
         // Calculate delta time
         double current_time = get_time();
         double dt = current_time - last_time;
         last_time = current_time;
         
-        // Limit delta time to prevent instability
-        if (dt > 0.016) dt = 0.016;
+        // Limit delta time to prevent instability; swept collisions stay
+        // exact at much longer steps
+        double max_dt = use_ccd ? CCD_MAX_DT : MAX_DT;
+        if (dt > max_dt) dt = max_dt;
         
-        // Update hexagon rotation
-        hexagon.angle += ROTATION_SPEED * dt;
-        update_hexagon(&hexagon);
-        
-        // Update ball physics
-        update_ball(&ball, &hexagon, dt);
-        
-        // Render
-        clear_screen(&gfx);
-        draw_hexagon(&gfx, &hexagon);
-        draw_ball(&gfx, &ball);
+        // Update hexagon rotation and ball physics
+        step_scene(balls, count, &hexagon, &grid, dt);
+        sim_time += dt;
+        frames++;
+        if (recording &&
+            !record_frame(recording, balls, count, &hexagon, sim_time)) {
+            fprintf(stderr, "Recording stopped: %s\n", strerror(errno));
+            traj_close(recording);
+            recording = NULL;
+        }
+        phases_lap(&phases, PHASE_PHYSICS);
         
-        XFlush(gfx.display);
-        usleep(16000); // ~60 FPS
+        draw_frame(&gfx, &fb, software, balls, count, &hexagon);
+        if (show_hud && !software) draw_hud(&gfx, software, &phases);
+        phases_lap(&phases, PHASE_DRAW);
+        show_frame(&gfx, &fb, software);
+        if (show_hud && software) draw_hud(&gfx, software, &phases);
+        phases_lap(&phases, PHASE_PRESENT);
+        phases_commit(&phases);
     }
     
+    print_pair_stats(&grid, count, frames);
+    pacer_report(&pacer, stderr);
+    evloop_report(&loop, stderr);
+    evloop_destroy(&loop);
+    phases_report(&phases, stderr);
+    if (phase_csv_path) {
+        FILE *csv = fopen(phase_csv_path, "w");
+        if (csv) {
+            phases_write_csv(&phases, csv);
+        }
+        if (!csv || fclose(csv) != 0) {
+            fprintf(stderr, "%s: %s\n", phase_csv_path, strerror(errno));
+        }
+    }
+    
+done:
+    if (!software) {
+        present_report(&gfx.present, stderr);
+    }
+    batch_report(&gfx.batch, stderr);
+    if (recording && !traj_close(recording)) {
+        fprintf(stderr, "%s: cannot write index\n", record_path);
+    }
+    if (software) {
+        fb_destroy(&fb);
+    }
+    batch_destroy(&gfx.batch);
+    present_destroy(&gfx.present);
     XCloseDisplay(gfx.display);
-    return 0;
+    hc_shape_free(&hexagon.shape);
+    grid_free(&grid);
+    free(balls);
+    return status;
+}
+
+#ifdef BALLHEX_BENCH
+#include "bench/bench.h"
+
+// One ball in the hexagon, stepped like step_scene() does
+typedef struct {
+    Ball ball;
+    Hexagon hex;
+} BenchState;
+
+static void *bench_init(const BenchScenario *sc) {
+    BenchState *st = malloc(sizeof(*st));
+    if (!st || !init_scene(&st->ball, 1, &st->hex)) {
+        free(st);
+        return NULL;
+    }
+    st->ball.pos = (Point){st->hex.center.x + sc->x * HEXAGON_RADIUS,
+                           st->hex.center.y + sc->y * HEXAGON_RADIUS};
+    st->ball.vel = (Point){sc->vx * HEXAGON_RADIUS / FIXED_DT,
+                           sc->vy * HEXAGON_RADIUS / FIXED_DT};
+    return st;
 }
+
+static int bench_step(void *state) {
+    BenchState *st = state;
+    st->hex.angle += ROTATION_SPEED * FIXED_DT;
+    update_hexagon(&st->hex);
+    return update_ball(&st->ball, &st->hex, FIXED_DT);
+}
+
+static void bench_fini(void *state) {
+    BenchState *st = state;
+    hc_shape_free(&st->hex.shape);
+    free(st);
+}
+
+const BenchModel bench_model = {"c4sr", bench_init, bench_step, bench_fini};
+#endif
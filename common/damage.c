@@ -0,0 +1,107 @@
+#include "damage.h"
+
+#include <math.h>
+
+void damage_init(Damage *d, int width, int height) {
+  *d = (Damage){.width = width, .height = height, .full = 1};
+}
+
+void damage_invalidate(Damage *d) { d->full = 1; }
+
+static int overlaps(const XRectangle *a, const XRectangle *b) {
+  return a->x < b->x + b->width && b->x < a->x + a->width &&
+         a->y < b->y + b->height && b->y < a->y + a->height;
+}
+
+static XRectangle bounding_box(const XRectangle *a, const XRectangle *b) {
+  int x0 = a->x < b->x ? a->x : b->x;
+  int y0 = a->y < b->y ? a->y : b->y;
+  int x1 = a->x + a->width > b->x + b->width ? a->x + a->width
+                                             : b->x + b->width;
+  int y1 = a->y + a->height > b->y + b->height ? a->y + a->height
+                                               : b->y + b->height;
+  return (XRectangle){x0, y0, x1 - x0, y1 - y0};
+}
+
+// Add r to a list of non-overlapping rectangles, merging until none
+// overlap. When the list is full r joins the last rectangle.
+static void add_rect(XRectangle *rects, int *count, int max, XRectangle r) {
+  for (int i = 0; i < *count;) {
+    if (overlaps(&rects[i], &r)) {
+      r = bounding_box(&rects[i], &r);
+      rects[i] = rects[--*count];
+      i = 0; // the grown rectangle may now overlap earlier ones
+    } else {
+      i++;
+    }
+  }
+  if (*count == max) {
+    r = bounding_box(&rects[max - 1], &r);
+    (*count)--;
+    add_rect(rects, count, max, r);
+    return;
+  }
+  rects[(*count)++] = r;
+}
+
+void damage_add(Damage *d, double x0, double y0, double x1, double y1) {
+  int ix0 = (int)floor(x0) - DAMAGE_PAD, iy0 = (int)floor(y0) - DAMAGE_PAD;
+  int ix1 = (int)ceil(x1) + DAMAGE_PAD, iy1 = (int)ceil(y1) + DAMAGE_PAD;
+  if (ix0 < 0)
+    ix0 = 0;
+  if (iy0 < 0)
+    iy0 = 0;
+  if (ix1 >= d->width)
+    ix1 = d->width - 1;
+  if (iy1 >= d->height)
+    iy1 = d->height - 1;
+  if (ix0 > ix1 || iy0 > iy1)
+    return;
+  add_rect(d->next, &d->next_count, DAMAGE_MAX_RECTS,
+           (XRectangle){ix0, iy0, ix1 - ix0 + 1, iy1 - iy0 + 1});
+}
+
+int damage_begin(Damage *d, Display *display, GC gc) {
+  d->region_count = 0;
+  if (d->full) {
+    d->region[d->region_count++] =
+        (XRectangle){0, 0, d->width, d->height};
+  } else {
+    for (int i = 0; i < d->prev_count; i++)
+      add_rect(d->region, &d->region_count, 2 * DAMAGE_MAX_RECTS, d->prev[i]);
+    for (int i = 0; i < d->next_count; i++)
+      add_rect(d->region, &d->region_count, 2 * DAMAGE_MAX_RECTS, d->next[i]);
+  }
+
+  uint64_t pixels = 0;
+  for (int i = 0; i < d->region_count; i++)
+    pixels += (uint64_t)d->region[i].width * d->region[i].height;
+  d->last_pixels = pixels;
+  d->pixels += pixels;
+  d->frames++;
+
+  for (int i = 0; i < d->next_count; i++)
+    d->prev[i] = d->next[i];
+  d->prev_count = d->next_count;
+  d->next_count = 0;
+  d->full = 0;
+
+  if (d->region_count)
+    XSetClipRectangles(display, gc, 0, 0, d->region, d->region_count,
+                       Unsorted);
+  return d->region_count;
+}
+
+void damage_end(Display *display, GC gc) {
+  XSetClipMask(display, gc, None);
+}
+
+void damage_report(const Damage *d, FILE *out) {
+  double full = (double)d->width * d->height;
+  double mean = d->frames ? (double)d->pixels / d->frames : 0.0;
+
+  fprintf(out,
+          "damage: %.0f pixels pushed per frame (%.1f%% of a full "
+          "redraw)\n",
+          mean, full > 0 ? 100.0 * mean / full : 0.0);
+}
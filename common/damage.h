@@ -0,0 +1,57 @@
+#ifndef COMMON_DAMAGE_H
+#define COMMON_DAMAGE_H
+
+#include <X11/Xlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Damage tracking for renderers that draw into a back-buffer pixmap and copy
+// it to the window.
+//
+// Each frame the caller adds the bounds of everything it is about to draw.
+// The damaged region is those bounds together with the previous frame's,
+// which covers both the new picture and the pixels the old one leaves
+// behind. damage_begin() installs the region as the GC's clip rectangles,
+// so the usual full-window clear, drawing and XCopyArea only touch damaged
+// pixels; over remote X or VNC only those are sent on.
+//
+// The region is kept as a handful of non-overlapping rectangles: bounds
+// that overlap are merged into their bounding box.
+#define DAMAGE_MAX_RECTS 8
+
+typedef struct {
+  int width, height;
+  XRectangle next[DAMAGE_MAX_RECTS]; // bounds added for the coming frame
+  int next_count;
+  XRectangle prev[DAMAGE_MAX_RECTS]; // bounds drawn in the last frame
+  int prev_count;
+  XRectangle region[2 * DAMAGE_MAX_RECTS]; // damaged this frame
+  int region_count;
+  int full; // redraw everything, e.g. for the first frame or after Expose
+  uint64_t frames;
+  uint64_t pixels;      // pixels pushed in all frames
+  uint64_t last_pixels; // pixels pushed in the last frame
+} Damage;
+
+void damage_init(Damage *d, int width, int height);
+
+// Damage the whole window for the next frame
+void damage_invalidate(Damage *d);
+
+// Bounds of something drawn in the coming frame, in pixels, inclusive.
+// Padded by DAMAGE_PAD for line width and rounding, and clipped to the
+// window.
+#define DAMAGE_PAD 2
+void damage_add(Damage *d, double x0, double y0, double x1, double y1);
+
+// Works out the damaged region, counts its pixels and clips gc to it.
+// Returns 0 if nothing needs drawing.
+int damage_begin(Damage *d, Display *display, GC gc);
+
+// Removes the clip again once the frame has been copied to the window
+void damage_end(Display *display, GC gc);
+
+// Prints the mean pixels pushed per frame and the share of full redraws
+void damage_report(const Damage *d, FILE *out);
+
+#endif
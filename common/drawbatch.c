@@ -0,0 +1,122 @@
+#include "drawbatch.h"
+
+#include <stdlib.h>
+
+// Request sizes in 4-byte units: PolyFillArc and PolySegment both have a
+// 3-unit header, then 3 units per arc and 2 per segment
+#define REQ_HEADER 3
+#define ARC_UNITS 3
+#define SEGMENT_UNITS 2
+
+void batch_init(DrawBatch *b, Display *display) {
+  long max = XMaxRequestSize(display);
+  *b = (DrawBatch){.display = display};
+  b->max_arcs = (int)((max - REQ_HEADER) / ARC_UNITS);
+  b->max_segments = (int)((max - REQ_HEADER) / SEGMENT_UNITS);
+  b->mark = NextRequest(display);
+}
+
+void batch_destroy(DrawBatch *b) {
+  for (int i = 0; i < b->cap_colors; i++) {
+    free(b->colors[i].arcs);
+    free(b->colors[i].segments);
+  }
+  free(b->colors);
+  *b = (DrawBatch){0};
+}
+
+// The queue for a colour, added after the others if it is new this frame.
+// Entries past num_colors keep their arrays for reuse.
+static DrawColor *find_color(DrawBatch *b, unsigned long color) {
+  for (int i = 0; i < b->num_colors; i++)
+    if (b->colors[i].color == color)
+      return &b->colors[i];
+
+  if (b->num_colors == b->cap_colors) {
+    int cap = b->cap_colors ? 2 * b->cap_colors : 4;
+    DrawColor *grown = realloc(b->colors, cap * sizeof(*grown));
+    if (!grown)
+      return NULL;
+    for (int i = b->cap_colors; i < cap; i++)
+      grown[i] = (DrawColor){0};
+    b->colors = grown;
+    b->cap_colors = cap;
+  }
+  DrawColor *c = &b->colors[b->num_colors++];
+  c->color = color;
+  return c;
+}
+
+// Make room for one more element of size bytes in *items
+static int reserve(void **items, int count, int *cap, size_t size) {
+  if (count < *cap)
+    return 1;
+  int grown_cap = *cap ? 2 * *cap : 64;
+  void *grown = realloc(*items, grown_cap * size);
+  if (!grown)
+    return 0;
+  *items = grown;
+  *cap = grown_cap;
+  return 1;
+}
+
+int batch_fill_arc(DrawBatch *b, unsigned long color, int x, int y,
+                   unsigned width, unsigned height) {
+  DrawColor *c = find_color(b, color);
+  if (!c || !reserve((void **)&c->arcs, c->num_arcs, &c->cap_arcs,
+                     sizeof(XArc)))
+    return 0;
+  c->arcs[c->num_arcs++] = (XArc){(short)x, (short)y, (unsigned short)width,
+                                  (unsigned short)height, 0, 360 * 64};
+  return 1;
+}
+
+int batch_segment(DrawBatch *b, unsigned long color, int x1, int y1, int x2,
+                  int y2) {
+  DrawColor *c = find_color(b, color);
+  if (!c || !reserve((void **)&c->segments, c->num_segments,
+                     &c->cap_segments, sizeof(XSegment)))
+    return 0;
+  c->segments[c->num_segments++] =
+      (XSegment){(short)x1, (short)y1, (short)x2, (short)y2};
+  return 1;
+}
+
+int batch_flush(DrawBatch *b, Drawable drawable, GC gc) {
+  int requests = 0;
+  for (int i = 0; i < b->num_colors; i++) {
+    DrawColor *c = &b->colors[i];
+    XSetForeground(b->display, gc, c->color);
+    for (int k = 0; k < c->num_segments; k += b->max_segments, requests++) {
+      int n = c->num_segments - k;
+      XDrawSegments(b->display, drawable, gc, c->segments + k,
+                    n < b->max_segments ? n : b->max_segments);
+    }
+    for (int k = 0; k < c->num_arcs; k += b->max_arcs, requests++) {
+      int n = c->num_arcs - k;
+      XFillArcs(b->display, drawable, gc, c->arcs + k,
+                n < b->max_arcs ? n : b->max_arcs);
+    }
+    c->num_arcs = 0;
+    c->num_segments = 0;
+  }
+  b->num_colors = 0;
+  return requests;
+}
+
+void batch_count_frame(DrawBatch *b) {
+  unsigned long now = NextRequest(b->display);
+  long sent = (long)(now - b->mark);
+  b->mark = now;
+  b->frames++;
+  b->requests += sent;
+  if (sent > b->max_requests)
+    b->max_requests = sent;
+}
+
+void batch_report(const DrawBatch *b, FILE *out) {
+  if (!b->frames)
+    return;
+  fprintf(out, "X requests per frame: mean %.1f, max %ld over %ld frames\n",
+          (double)b->requests / b->frames, b->max_requests, b->frames);
+}
@@ -0,0 +1,52 @@
+#ifndef COMMON_DRAWBATCH_H
+#define COMMON_DRAWBATCH_H
+
+#include <X11/Xlib.h>
+#include <stdio.h>
+
+// Core drawing grouped by colour. Shapes are queued during a frame and
+// batch_flush() sends each colour's filled arcs with one XFillArcs and its
+// segments with one XDrawSegments, after a single foreground change. A list
+// is only split where a request would exceed the server's maximum request
+// size, at the same point Xlib would split it, so every call is exactly one
+// request. The queues keep their memory between frames.
+//
+// The batch also counts the requests sent per shown frame, for whichever
+// drawing path is in use, from the connection's request serial.
+typedef struct {
+  unsigned long color;
+  XArc *arcs;
+  int num_arcs, cap_arcs;
+  XSegment *segments;
+  int num_segments, cap_segments;
+} DrawColor;
+
+typedef struct {
+  Display *display;
+  DrawColor *colors;
+  int num_colors, cap_colors;
+  int max_arcs, max_segments; // per request
+  unsigned long mark;         // request serial at the end of the last frame
+  long frames, requests, max_requests;
+} DrawBatch;
+
+void batch_init(DrawBatch *b, Display *display);
+void batch_destroy(DrawBatch *b);
+
+// Queue a shape; returns 0 and drops it if the queue cannot grow
+int batch_fill_arc(DrawBatch *b, unsigned long color, int x, int y,
+                   unsigned width, unsigned height);
+int batch_segment(DrawBatch *b, unsigned long color, int x1, int y1, int x2,
+                  int y2);
+
+// Draws and empties every queue in order of first use; returns the number
+// of drawing requests sent
+int batch_flush(DrawBatch *b, Drawable drawable, GC gc);
+
+// Call once per shown frame, after presenting it
+void batch_count_frame(DrawBatch *b);
+
+// Mean and peak requests per frame
+void batch_report(const DrawBatch *b, FILE *out);
+
+#endif
@@ -0,0 +1,94 @@
+#include "eventloop.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void evloop_init(EventLoop *loop, Display *display) {
+  *loop = (EventLoop){
+      .display = display,
+      .timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC),
+      .start_ns = now_ns(),
+  };
+}
+
+void evloop_destroy(EventLoop *loop) {
+  if (loop->timer_fd >= 0)
+    close(loop->timer_fd);
+  loop->timer_fd = -1;
+}
+
+int evloop_wait(EventLoop *loop, Pacer *pacer) {
+  int64_t deadline = pacer_deadline(pacer);
+
+  if (loop->timer_fd >= 0) {
+    struct itimerspec when = {
+        .it_value = {deadline / 1000000000, deadline % 1000000000}};
+    timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &when, NULL);
+  }
+  // Requests must reach the server before we sleep on its replies
+  XFlush(loop->display);
+
+  for (;;) {
+    // Events Xlib has already read off the socket will not wake poll()
+    if (XEventsQueued(loop->display, QueuedAlready) > 0) {
+      loop->input_wakeups++;
+      return 0;
+    }
+    int64_t now = now_ns();
+    if (now >= deadline)
+      break;
+
+    struct pollfd fds[2] = {
+        {.fd = ConnectionNumber(loop->display), .events = POLLIN},
+        {.fd = loop->timer_fd, .events = POLLIN},
+    };
+    int nfds = loop->timer_fd >= 0 ? 2 : 1;
+    int timeout = -1;
+    if (loop->timer_fd < 0)
+      timeout = (int)((deadline - now + 999999) / 1000000);
+    int ready = poll(fds, nfds, timeout);
+    if (ready < 0 && errno != EINTR)
+      break;
+    if (ready > 0 && (fds[0].revents & POLLIN)) {
+      // Read the new events into Xlib's queue
+      if (XEventsQueued(loop->display, QueuedAfterReading) > 0) {
+        loop->input_wakeups++;
+        return 0;
+      }
+    }
+    if (ready > 0 && nfds == 2 && (fds[1].revents & POLLIN)) {
+      uint64_t expirations;
+      if (read(loop->timer_fd, &expirations, sizeof(expirations)) < 0 &&
+          errno != EAGAIN)
+        break;
+    }
+  }
+  pacer_tick(pacer);
+  loop->frames++;
+  return 1;
+}
+
+void evloop_report(const EventLoop *loop, FILE *out) {
+  struct rusage usage;
+  double wall = (now_ns() - loop->start_ns) * 1e-9;
+  double cpu = 0.0;
+
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 +
+          usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+  fprintf(out,
+          "wakeups: %llu frames, %llu for input; cpu %.1f%% of one core\n",
+          (unsigned long long)loop->frames,
+          (unsigned long long)loop->input_wakeups,
+          wall > 0 ? 100.0 * cpu / wall : 0.0);
+}
@@ -0,0 +1,41 @@
+#ifndef COMMON_EVENTLOOP_H
+#define COMMON_EVENTLOOP_H
+
+#include <X11/Xlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pacer.h"
+
+// Frame loop that sleeps in poll() on the X connection and a timerfd armed
+// for the pacer's next deadline, so it wakes only for X input or for the
+// next frame. Input is then handled as soon as it arrives instead of once
+// per frame, and an idle viewer costs nothing between frames.
+//
+// Typical use, with the usual XPending() loop to drain events:
+//
+//   while (running) {
+//     int frame = evloop_wait(&loop, &pacer);
+//     while (XPending(display)) { ... }
+//     if (!frame) continue;
+//     ... step and draw ...
+//   }
+typedef struct {
+  Display *display;
+  int timer_fd; // -1 if no timerfd could be made: poll() times out instead
+  uint64_t frames;
+  uint64_t input_wakeups;
+  int64_t start_ns;
+} EventLoop;
+
+void evloop_init(EventLoop *loop, Display *display);
+void evloop_destroy(EventLoop *loop);
+
+// Blocks until X events are queued or the pacer's next frame is due.
+// Returns 1 for a frame (the pacer has ticked) and 0 for input only.
+int evloop_wait(EventLoop *loop, Pacer *pacer);
+
+// Prints the wakeups and the CPU time used per second of wall time
+void evloop_report(const EventLoop *loop, FILE *out);
+
+#endif
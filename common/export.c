@@ -0,0 +1,375 @@
+#include "export.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+  SLOT_FREE,   // ready for the caller
+  SLOT_QUEUED, // submitted, waiting for a worker
+  SLOT_BUSY,   // being drawn and encoded
+  SLOT_DONE,   // encoded, waiting to be written in order
+};
+
+struct ExportSlot {
+  int state;
+  uint64_t frame;
+  void *scene;
+  uint8_t *data; // encoded Y4M frame
+  size_t size;
+};
+
+static const char y4m_frame_header[] = "FRAME\n";
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void fail(Exporter *vx, int error) {
+  pthread_mutex_lock(&vx->lock);
+  if (!vx->failed)
+    vx->error = error;
+  vx->failed = 1;
+  pthread_mutex_unlock(&vx->lock);
+}
+
+// Full-range BT.601 (JFIF) in 8-bit fixed point. The chroma offsets fold
+// in the +128 bias and rounding, so the shifts never see a negative value.
+static inline uint8_t luma(int r, int g, int b) {
+  return (uint8_t)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+static inline uint8_t chroma_b(int r, int g, int b) {
+  return (uint8_t)((-43 * r - 85 * g + 128 * b + 32895) >> 8);
+}
+
+static inline uint8_t chroma_r(int r, int g, int b) {
+  return (uint8_t)((128 * r - 107 * g - 21 * b + 32895) >> 8);
+}
+
+// One Y4M frame: the frame header, then the Y, Cb and Cr planes, with
+// chroma taken from the mean of each 2x2 block
+static void encode_y4m(const Framebuffer *fb, uint8_t *out) {
+  int w = fb->width, h = fb->height;
+  memcpy(out, y4m_frame_header, sizeof(y4m_frame_header) - 1);
+  uint8_t *y_plane = out + sizeof(y4m_frame_header) - 1;
+  uint8_t *cb_plane = y_plane + (size_t)w * h;
+  uint8_t *cr_plane = cb_plane + (size_t)(w / 2) * (h / 2);
+
+  for (int y = 0; y < h; y++) {
+    const uint32_t *row = fb->pixels + (size_t)y * fb->stride;
+    uint8_t *luma_row = y_plane + (size_t)y * w;
+#pragma omp simd
+    for (int x = 0; x < w; x++)
+      luma_row[x] = luma(row[x] >> 16 & 0xff, row[x] >> 8 & 0xff,
+                         row[x] & 0xff);
+  }
+  for (int y = 0; y < h / 2; y++) {
+    const uint32_t *top = fb->pixels + (size_t)(2 * y) * fb->stride;
+    const uint32_t *bottom = top + fb->stride;
+    uint8_t *cb_row = cb_plane + (size_t)y * (w / 2);
+    uint8_t *cr_row = cr_plane + (size_t)y * (w / 2);
+    for (int x = 0; x < w / 2; x++) {
+      uint32_t p[4] = {top[2 * x], top[2 * x + 1], bottom[2 * x],
+                       bottom[2 * x + 1]};
+      int r = 2, g = 2, b = 2; // round the mean
+      for (int k = 0; k < 4; k++) {
+        r += p[k] >> 16 & 0xff;
+        g += p[k] >> 8 & 0xff;
+        b += p[k] & 0xff;
+      }
+      cb_row[x] = chroma_b(r >> 2, g >> 2, b >> 2);
+      cr_row[x] = chroma_r(r >> 2, g >> 2, b >> 2);
+    }
+  }
+}
+
+// One binary PPM file for the frame; returns 0 with errno set on failure
+static int write_ppm(const Exporter *vx, const Framebuffer *fb, uint64_t frame,
+                     uint8_t *rgb, uint64_t *bytes) {
+  char name[4096];
+  if (snprintf(name, sizeof(name), vx->path, (int)frame) >= (int)sizeof(name)) {
+    errno = ENAMETOOLONG;
+    return 0;
+  }
+  FILE *f = fopen(name, "wb");
+  if (!f)
+    return 0;
+
+  for (int y = 0; y < fb->height; y++) {
+    const uint32_t *row = fb->pixels + (size_t)y * fb->stride;
+    uint8_t *out = rgb + (size_t)y * fb->width * 3;
+    for (int x = 0; x < fb->width; x++) {
+      out[3 * x] = row[x] >> 16 & 0xff;
+      out[3 * x + 1] = row[x] >> 8 & 0xff;
+      out[3 * x + 2] = row[x] & 0xff;
+    }
+  }
+  size_t size = (size_t)fb->width * fb->height * 3;
+  int header = fprintf(f, "P6\n%d %d\n255\n", fb->width, fb->height);
+  int ok = header > 0 && fwrite(rgb, 1, size, f) == size;
+  if (fclose(f) != 0)
+    ok = 0;
+  if (ok)
+    *bytes += header + size;
+  return ok;
+}
+
+static void *worker_main(void *arg) {
+  Exporter *vx = arg;
+  Framebuffer fb;
+  uint8_t *rgb = NULL;
+  uint64_t bytes = 0;
+
+  if (!fb_init_memory(&fb, vx->width, vx->height) ||
+      (vx->format == EXPORT_PPM &&
+       !(rgb = malloc((size_t)vx->width * vx->height * 3))))
+    fail(vx, ENOMEM);
+
+  pthread_mutex_lock(&vx->lock);
+  for (;;) {
+    while (vx->taken == vx->submitted && !vx->closing)
+      pthread_cond_wait(&vx->changed, &vx->lock);
+    if (vx->taken == vx->submitted)
+      break;
+    ExportSlot *slot = &vx->slots[vx->taken++ % vx->num_slots];
+    slot->state = SLOT_BUSY;
+    int skip = vx->failed;
+    pthread_mutex_unlock(&vx->lock);
+
+    // Once anything has failed the remaining frames are only retired
+    if (!skip) {
+      vx->render(&fb, slot->scene, vx->render_ctx);
+      if (vx->format == EXPORT_Y4M)
+        encode_y4m(&fb, slot->data);
+      else if (!write_ppm(vx, &fb, slot->frame, rgb, &bytes))
+        fail(vx, errno);
+    }
+
+    pthread_mutex_lock(&vx->lock);
+    slot->state = SLOT_DONE;
+    pthread_cond_broadcast(&vx->changed);
+  }
+  vx->bytes += bytes;
+  pthread_mutex_unlock(&vx->lock);
+
+  free(rgb);
+  fb_destroy(&fb);
+  return NULL;
+}
+
+// Write the oldest unwritten frame, which must be done, and free its slot
+static void retire(Exporter *vx, ExportSlot *slot) {
+  pthread_mutex_lock(&vx->lock);
+  int write = vx->format == EXPORT_Y4M && !vx->failed;
+  pthread_mutex_unlock(&vx->lock);
+
+  int ok = !write || fwrite(slot->data, 1, slot->size, vx->out) == slot->size;
+  if (!ok)
+    fail(vx, errno);
+
+  pthread_mutex_lock(&vx->lock);
+  if (write && ok)
+    vx->bytes += slot->size;
+  slot->state = SLOT_FREE;
+  vx->written++;
+  pthread_mutex_unlock(&vx->lock);
+}
+
+// Wait until slot is done or free. Returns 1 if it is done.
+static int wait_done(Exporter *vx, ExportSlot *slot) {
+  pthread_mutex_lock(&vx->lock);
+  while (slot->state == SLOT_QUEUED || slot->state == SLOT_BUSY)
+    pthread_cond_wait(&vx->changed, &vx->lock);
+  int done = slot->state == SLOT_DONE;
+  pthread_mutex_unlock(&vx->lock);
+  return done;
+}
+
+static void free_slots(Exporter *vx) {
+  for (int i = 0; i < vx->num_slots; i++) {
+    free(vx->slots[i].scene);
+    free(vx->slots[i].data);
+  }
+  free(vx->slots);
+}
+
+// Number of %d conversions in path, or -1 if it holds any other '%'
+// besides "%%"
+static int path_conversions(const char *path) {
+  int conversions = 0;
+  for (const char *c = strchr(path, '%'); c; c = strchr(c, '%')) {
+    c++;
+    if (*c == '%') {
+      c++;
+      continue;
+    }
+    // %d with an optional zero flag and width, nothing else
+    if (*c == '0')
+      c++;
+    while (*c >= '0' && *c <= '9')
+      c++;
+    if (*c != 'd')
+      return -1;
+    conversions++;
+  }
+  return conversions;
+}
+
+int vx_path_ok(const char *path) {
+  int conversions = path_conversions(path);
+  return conversions >= 0 && conversions <= 1;
+}
+
+int vx_open(Exporter *vx, const char *path, int width, int height,
+            int fps_num, int fps_den, size_t scene_size, int num_workers,
+            ExportRender render, void *render_ctx) {
+  *vx = (Exporter){
+      .format = path_conversions(path) == 1 ? EXPORT_PPM : EXPORT_Y4M,
+      .path = path,
+      .width = width,
+      .height = height,
+      .render = render,
+      .render_ctx = render_ctx,
+      .num_workers = num_workers,
+      .num_slots = 2 * num_workers,
+      .scene_size = scene_size,
+      .start_ns = now_ns(),
+  };
+  // 4:2:0 chroma needs whole 2x2 blocks
+  if (num_workers < 1 || !vx_path_ok(path) ||
+      (vx->format == EXPORT_Y4M && (width % 2 || height % 2))) {
+    errno = EINVAL;
+    return 0;
+  }
+
+  size_t frame_size = sizeof(y4m_frame_header) - 1 +
+                      (size_t)width * height * 3 / 2;
+  vx->slots = calloc(vx->num_slots, sizeof(ExportSlot));
+  vx->workers = malloc(num_workers * sizeof(pthread_t));
+  if (!vx->slots || !vx->workers) {
+    free(vx->slots);
+    free(vx->workers);
+    errno = ENOMEM;
+    return 0;
+  }
+  for (int i = 0; i < vx->num_slots; i++) {
+    ExportSlot *slot = &vx->slots[i];
+    slot->scene = malloc(scene_size);
+    if (vx->format == EXPORT_Y4M) {
+      slot->size = frame_size;
+      slot->data = malloc(frame_size);
+    }
+    if (!slot->scene || (vx->format == EXPORT_Y4M && !slot->data)) {
+      free_slots(vx);
+      free(vx->workers);
+      errno = ENOMEM;
+      return 0;
+    }
+  }
+
+  if (vx->format == EXPORT_Y4M) {
+    // A stream path is a file name as it stands once "%%" is unescaped
+    char name[4096];
+    size_t n = 0;
+    for (const char *c = path; *c && n < sizeof(name) - 1; c++) {
+      name[n++] = *c;
+      if (c[0] == '%' && c[1] == '%')
+        c++;
+    }
+    name[n] = '\0';
+    vx->out = strcmp(path, "-") == 0 ? stdout : fopen(name, "wb");
+    int header = vx->out ? fprintf(vx->out,
+                                   "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 "
+                                   "C420jpeg\n",
+                                   width, height, fps_num, fps_den)
+                         : -1;
+    if (header < 0) {
+      int error = errno;
+      if (vx->out && vx->out != stdout)
+        fclose(vx->out);
+      free_slots(vx);
+      free(vx->workers);
+      errno = error;
+      return 0;
+    }
+    vx->bytes = header;
+  }
+
+  pthread_mutex_init(&vx->lock, NULL);
+  pthread_cond_init(&vx->changed, NULL);
+  for (int i = 0; i < num_workers; i++) {
+    int err = pthread_create(&vx->workers[i], NULL, worker_main, vx);
+    if (err) {
+      // Let the workers already started drain and exit
+      vx->num_workers = i;
+      vx_close(vx);
+      errno = err;
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void *vx_frame(Exporter *vx) {
+  // Slots are used in turn, so a busy one holds the oldest unwritten frame
+  ExportSlot *slot = &vx->slots[vx->submitted % vx->num_slots];
+  if (wait_done(vx, slot))
+    retire(vx, slot);
+  return slot->scene;
+}
+
+void vx_submit(Exporter *vx) {
+  pthread_mutex_lock(&vx->lock);
+  ExportSlot *slot = &vx->slots[vx->submitted % vx->num_slots];
+  slot->state = SLOT_QUEUED;
+  slot->frame = vx->submitted++;
+  pthread_cond_broadcast(&vx->changed);
+  pthread_mutex_unlock(&vx->lock);
+}
+
+int vx_close(Exporter *vx) {
+  while (vx->written < vx->submitted) {
+    ExportSlot *slot = &vx->slots[vx->written % vx->num_slots];
+    wait_done(vx, slot);
+    retire(vx, slot);
+  }
+
+  pthread_mutex_lock(&vx->lock);
+  vx->closing = 1;
+  pthread_cond_broadcast(&vx->changed);
+  pthread_mutex_unlock(&vx->lock);
+  for (int i = 0; i < vx->num_workers; i++)
+    pthread_join(vx->workers[i], NULL);
+
+  if (vx->out && fflush(vx->out) != 0)
+    fail(vx, errno);
+  if (vx->out && vx->out != stdout && fclose(vx->out) != 0)
+    fail(vx, errno);
+  vx->out = NULL;
+  vx->end_ns = now_ns();
+
+  pthread_cond_destroy(&vx->changed);
+  pthread_mutex_destroy(&vx->lock);
+  free_slots(vx);
+  free(vx->workers);
+  vx->slots = NULL;
+  vx->workers = NULL;
+  if (vx->failed)
+    errno = vx->error;
+  return !vx->failed;
+}
+
+void vx_report(const Exporter *vx, FILE *out) {
+  double elapsed = (vx->end_ns - vx->start_ns) * 1e-9;
+  fprintf(out,
+          "exported %llu frames (%s, %dx%d) on %d workers in %.3f s: "
+          "%.1f frames/s, %.1f MB\n",
+          (unsigned long long)vx->written,
+          vx->format == EXPORT_Y4M ? "y4m" : "ppm", vx->width, vx->height,
+          vx->num_workers, elapsed,
+          elapsed > 0 ? vx->written / elapsed : 0.0, vx->bytes / 1e6);
+}
@@ -0,0 +1,84 @@
+#ifndef COMMON_EXPORT_H
+#define COMMON_EXPORT_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "framebuffer.h"
+
+// Offscreen video export, as fast as the CPU allows.
+//
+// The caller simulates on its own thread and hands each frame over as a
+// scene: a fixed-size, self-contained copy of whatever it needs to draw.
+// A pool of workers draws every scene into a memory framebuffer with the
+// caller's render function and encodes it, several frames at a time. The
+// frames are written in order:
+//
+//   - a path containing one %d conversion, optionally zero-padded to a
+//     width ("frames/%05d.ppm"), gets one binary PPM per frame, written by
+//     the workers themselves;
+//   - a path with no conversion, or "-" for stdout, gets one YUV4MPEG2
+//     (Y4M) stream of 4:2:0 frames, written in order from the caller's
+//     thread. Most video tools read it directly, e.g.
+//     ffmpeg -i run.y4m run.mp4.
+//
+// In either, "%%" stands for a literal '%'.
+
+// Draws scene into fb, which is width x height and holds 0xRRGGBB pixels
+typedef void (*ExportRender)(Framebuffer *fb, const void *scene, void *ctx);
+
+typedef enum { EXPORT_Y4M, EXPORT_PPM } ExportFormat;
+
+typedef struct ExportSlot ExportSlot;
+
+typedef struct {
+  ExportFormat format;
+  const char *path;
+  FILE *out; // Y4M stream
+  int width, height;
+  ExportRender render;
+  void *render_ctx;
+
+  int num_workers;
+  pthread_t *workers;
+  int num_slots; // frames in flight
+  ExportSlot *slots;
+  size_t scene_size;
+  pthread_mutex_t lock;
+  pthread_cond_t changed; // a slot was submitted or finished
+  uint64_t submitted;     // frames handed to vx_submit()
+  uint64_t taken;         // frames picked up by workers
+  uint64_t written;       // frames finished in order
+  int closing;
+  int failed;     // a frame could not be written
+  int error;      // errno of the first failure
+  uint64_t bytes; // written so far
+  int64_t start_ns, end_ns;
+} Exporter;
+
+// Whether path names an output vx_open() accepts: at most one %d, %0Nd or
+// %Nd, and no other '%' than "%%"
+int vx_path_ok(const char *path);
+
+// Starts num_workers workers. fps is the rate written to a Y4M header as
+// fps_num / fps_den. Returns 0 with errno set if the output cannot be
+// opened or the pool cannot be started.
+int vx_open(Exporter *vx, const char *path, int width, int height,
+            int fps_num, int fps_den, size_t scene_size, int num_workers,
+            ExportRender render, void *render_ctx);
+
+// Returns the scene for the next frame, to be filled and then passed on
+// with vx_submit(). Blocks while every slot is in flight.
+void *vx_frame(Exporter *vx);
+void vx_submit(Exporter *vx);
+
+// Waits for the remaining frames and stops the pool. Returns 0 with errno
+// set if any frame could not be written.
+int vx_close(Exporter *vx);
+
+// Frames, throughput and output size
+void vx_report(const Exporter *vx, FILE *out);
+
+#endif
@@ -0,0 +1,211 @@
+#include "framebuffer.h"
+
+#include <X11/Xutil.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+static int shm_attach_failed;
+
+static int shm_error_handler(Display *display, XErrorEvent *event) {
+  (void)display;
+  (void)event;
+  shm_attach_failed = 1;
+  return 0;
+}
+
+// Attach a shared-memory image; returns 0 if the server cannot use it
+static int init_shm(Framebuffer *fb, Visual *visual, int depth) {
+  if (!XShmQueryExtension(fb->display))
+    return 0;
+
+  fb->image = XShmCreateImage(fb->display, visual, depth, ZPixmap, NULL,
+                              &fb->shminfo, fb->width, fb->height);
+  if (!fb->image)
+    return 0;
+
+  fb->shminfo.shmid = shmget(IPC_PRIVATE,
+                             fb->image->bytes_per_line * fb->image->height,
+                             IPC_CREAT | 0600);
+  if (fb->shminfo.shmid < 0) {
+    XDestroyImage(fb->image);
+    return 0;
+  }
+  fb->shminfo.shmaddr = shmat(fb->shminfo.shmid, NULL, 0);
+  if (fb->shminfo.shmaddr == (char *)-1) {
+    shmctl(fb->shminfo.shmid, IPC_RMID, NULL);
+    XDestroyImage(fb->image);
+    fb->image = NULL;
+    return 0;
+  }
+  fb->image->data = fb->shminfo.shmaddr;
+  fb->shminfo.readOnly = False;
+
+  // A remote server accepts the request but fails it asynchronously
+  shm_attach_failed = 0;
+  XSync(fb->display, False);
+  int (*old_handler)(Display *, XErrorEvent *) =
+      XSetErrorHandler(shm_error_handler);
+  XShmAttach(fb->display, &fb->shminfo);
+  XSync(fb->display, False);
+  XSetErrorHandler(old_handler);
+
+  // The segment goes away once both sides have detached
+  shmctl(fb->shminfo.shmid, IPC_RMID, NULL);
+
+  if (shm_attach_failed) {
+    shmdt(fb->shminfo.shmaddr);
+    fb->image->data = NULL;
+    XDestroyImage(fb->image);
+    fb->image = NULL;
+    return 0;
+  }
+  return 1;
+}
+
+int fb_init(Framebuffer *fb, Display *display, Drawable drawable, GC gc,
+            int width, int height) {
+  int screen = DefaultScreen(display);
+  Visual *visual = DefaultVisual(display, screen);
+  int depth = DefaultDepth(display, screen);
+
+  *fb = (Framebuffer){.display = display,
+                      .drawable = drawable,
+                      .gc = gc,
+                      .width = width,
+                      .height = height};
+
+  if (visual->class != TrueColor || depth < 24)
+    return 0;
+
+  fb->use_shm = init_shm(fb, visual, depth);
+  if (!fb->use_shm) {
+    char *data = malloc((size_t)width * height * 4);
+    if (!data)
+      return 0;
+    fb->image = XCreateImage(display, visual, depth, ZPixmap, 0, data, width,
+                             height, 32, 0);
+    if (!fb->image) {
+      free(data);
+      return 0;
+    }
+  }
+
+  // Pixels are written as native 32-bit words
+  const uint32_t one = 1;
+  int host_order = *(const char *)&one ? LSBFirst : MSBFirst;
+  if (fb->image->bits_per_pixel != 32 || fb->image->byte_order != host_order) {
+    fb_destroy(fb);
+    return 0;
+  }
+  fb->pixels = (uint32_t *)fb->image->data;
+  fb->stride = fb->image->bytes_per_line / 4;
+  return 1;
+}
+
+int fb_init_memory(Framebuffer *fb, int width, int height) {
+  *fb = (Framebuffer){.width = width, .height = height, .stride = width};
+  fb->pixels = malloc((size_t)width * height * sizeof(uint32_t));
+  return fb->pixels != NULL;
+}
+
+void fb_destroy(Framebuffer *fb) {
+  if (!fb->image) {
+    // fb_init_memory() pixels, if any
+    free(fb->pixels);
+    fb->pixels = NULL;
+    return;
+  }
+  if (fb->use_shm) {
+    XShmDetach(fb->display, &fb->shminfo);
+    XSync(fb->display, False);
+    shmdt(fb->shminfo.shmaddr);
+    fb->image->data = NULL;
+  }
+  XDestroyImage(fb->image); // Also frees the malloc'd pixels
+  fb->image = NULL;
+  fb->pixels = NULL;
+}
+
+// Fill pixels [x0, x1) of one row. Every span write is a contiguous run of
+// 32-bit stores, which the compiler turns into vector stores.
+static void fill_span(uint32_t *row, int x0, int x1, uint32_t color) {
+#pragma omp simd
+  for (int x = x0; x < x1; x++)
+    row[x] = color;
+}
+
+void fb_clear(Framebuffer *fb, uint32_t color) {
+  for (int y = 0; y < fb->height; y++)
+    fill_span(fb->pixels + (size_t)y * fb->stride, 0, fb->width, color);
+}
+
+// Scanline fill: each row covered by the circle becomes one span
+void fb_fill_circle(Framebuffer *fb, double cx, double cy, double radius,
+                    uint32_t color) {
+  int y0 = (int)ceil(cy - radius - 0.5);
+  int y1 = (int)floor(cy + radius - 0.5);
+  if (y0 < 0)
+    y0 = 0;
+  if (y1 > fb->height - 1)
+    y1 = fb->height - 1;
+
+  for (int y = y0; y <= y1; y++) {
+    double dy = y + 0.5 - cy;
+    double half = radius * radius - dy * dy;
+    if (half <= 0)
+      continue;
+    half = sqrt(half);
+    int x0 = (int)ceil(cx - half - 0.5);
+    int x1 = (int)floor(cx + half - 0.5) + 1;
+    if (x0 < 0)
+      x0 = 0;
+    if (x1 > fb->width)
+      x1 = fb->width;
+    if (x0 < x1)
+      fill_span(fb->pixels + (size_t)y * fb->stride, x0, x1, color);
+  }
+}
+
+// DDA along the major axis, widened to a short span across the minor axis
+void fb_draw_line(Framebuffer *fb, double x0, double y0, double x1, double y1,
+                  int width, uint32_t color) {
+  double dx = x1 - x0, dy = y1 - y0;
+  int steep = fabs(dy) > fabs(dx);
+  int steps = (int)ceil(fmax(fabs(dx), fabs(dy)));
+  if (steps == 0)
+    steps = 1;
+  double sx = dx / steps, sy = dy / steps;
+  int lo = -(width - 1) / 2, hi = width / 2;
+
+  for (int i = 0; i <= steps; i++) {
+    int x = (int)floor(x0 + sx * i);
+    int y = (int)floor(y0 + sy * i);
+    if (steep) {
+      if (y < 0 || y >= fb->height)
+        continue;
+      int a = x + lo < 0 ? 0 : x + lo;
+      int b = x + hi + 1 > fb->width ? fb->width : x + hi + 1;
+      if (a < b)
+        fill_span(fb->pixels + (size_t)y * fb->stride, a, b, color);
+    } else {
+      if (x < 0 || x >= fb->width)
+        continue;
+      for (int k = y + lo; k <= y + hi; k++)
+        if (k >= 0 && k < fb->height)
+          fb->pixels[(size_t)k * fb->stride + x] = color;
+    }
+  }
+}
+
+void fb_present(Framebuffer *fb) {
+  if (fb->use_shm)
+    XShmPutImage(fb->display, fb->drawable, fb->gc, fb->image, 0, 0, 0, 0,
+                 fb->width, fb->height, False);
+  else
+    XPutImage(fb->display, fb->drawable, fb->gc, fb->image, 0, 0, 0, 0,
+              fb->width, fb->height);
+  XSync(fb->display, False);
+}
@@ -0,0 +1,49 @@
+#ifndef COMMON_FRAMEBUFFER_H
+#define COMMON_FRAMEBUFFER_H
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+#include <stdint.h>
+
+// Client-side software framebuffer presented to an X window in one request.
+//
+// Pixels live in an XImage backed by a MIT-SHM segment when the server
+// supports it (local displays), so presenting a frame costs one
+// XShmPutImage and no pixel copy through the socket. When SHM is missing or
+// the attach fails (remote displays) the image is kept in ordinary memory
+// and sent with XPutImage instead.
+//
+// Only 32 bits-per-pixel TrueColor visuals are handled; fb_init() fails on
+// anything else and callers keep their core-protocol drawing.
+//
+// fb_init_memory() makes a framebuffer with no display at all, for drawing
+// frames that are never shown (see common/export.h). Pixels are 0xRRGGBB.
+typedef struct {
+  Display *display;
+  Drawable drawable;
+  GC gc;
+  XImage *image;
+  XShmSegmentInfo shminfo;
+  int use_shm;
+  int width, height;
+  uint32_t *pixels;
+  int stride; // in pixels
+} Framebuffer;
+
+int fb_init(Framebuffer *fb, Display *display, Drawable drawable, GC gc,
+            int width, int height);
+int fb_init_memory(Framebuffer *fb, int width, int height);
+void fb_destroy(Framebuffer *fb);
+
+void fb_clear(Framebuffer *fb, uint32_t color);
+void fb_fill_circle(Framebuffer *fb, double cx, double cy, double radius,
+                    uint32_t color);
+void fb_draw_line(Framebuffer *fb, double x0, double y0, double x1, double y1,
+                  int width, uint32_t color);
+
+// Sends the frame to the drawable (not for fb_init_memory() framebuffers)
+// and waits until the server has consumed it, so the next frame can be drawn
+// into the same memory.
+void fb_present(Framebuffer *fb);
+
+#endif
@@ -0,0 +1,60 @@
+#include "histogram.h"
+
+#define SUB_COUNT (1 << HIST_SUB_BITS)
+
+static int bucket_index(uint64_t v) {
+  if (v < SUB_COUNT)
+    return (int)v;
+  int msb = 63 - __builtin_clzll(v);
+  int shift = msb - HIST_SUB_BITS;
+  return (shift + 1) * SUB_COUNT + (int)((v >> shift) & (SUB_COUNT - 1));
+}
+
+uint64_t hist_bucket_floor(int i) {
+  if (i < SUB_COUNT)
+    return (uint64_t)i;
+  int shift = i / SUB_COUNT - 1;
+  return (uint64_t)(SUB_COUNT + i % SUB_COUNT) << shift;
+}
+
+static uint64_t bucket_width(int i) {
+  return i < SUB_COUNT ? 1 : (uint64_t)1 << (i / SUB_COUNT - 1);
+}
+
+void hist_reset(Histogram *h) { *h = (Histogram){.min = UINT64_MAX}; }
+
+void hist_record(Histogram *h, uint64_t value) {
+  h->counts[bucket_index(value)]++;
+  h->total++;
+  h->sum += (double)value;
+  if (value < h->min)
+    h->min = value;
+  if (value > h->max)
+    h->max = value;
+}
+
+double hist_mean(const Histogram *h) {
+  return h->total ? h->sum / h->total : 0.0;
+}
+
+uint64_t hist_percentile(const Histogram *h, double fraction) {
+  if (h->total == 0)
+    return 0;
+  uint64_t rank = (uint64_t)(fraction * h->total);
+  if (rank >= h->total)
+    rank = h->total - 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen > rank) {
+      uint64_t v = hist_bucket_floor(i) + bucket_width(i) / 2;
+      if (v < h->min)
+        v = h->min;
+      if (v > h->max)
+        v = h->max;
+      return v;
+    }
+  }
+  return h->max;
+}
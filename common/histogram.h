@@ -0,0 +1,31 @@
+#ifndef COMMON_HISTOGRAM_H
+#define COMMON_HISTOGRAM_H
+
+#include <stdint.h>
+
+// Fixed-size log-bucketed histogram for non-negative integer samples such as
+// durations in nanoseconds. Each power of two is split into 2^HIST_SUB_BITS
+// linear buckets, so any recorded value is known to within ~3%. Recording
+// never allocates.
+#define HIST_SUB_BITS 4
+#define HIST_BUCKETS (64 << HIST_SUB_BITS)
+
+typedef struct {
+  uint64_t counts[HIST_BUCKETS];
+  uint64_t total;
+  uint64_t min, max;
+  double sum;
+} Histogram;
+
+void hist_reset(Histogram *h);
+void hist_record(Histogram *h, uint64_t value);
+double hist_mean(const Histogram *h);
+
+// Value below which the given fraction (0..1) of the samples fall, reported
+// as the midpoint of its bucket and clamped to the observed range.
+uint64_t hist_percentile(const Histogram *h, double fraction);
+
+// Smallest value that falls into bucket i
+uint64_t hist_bucket_floor(int i);
+
+#endif
@@ -0,0 +1,76 @@
+#include "pacer.h"
+
+#include <errno.h>
+#include <time.h>
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void pacer_init(Pacer *p, double hz) {
+  p->period_ns = (int64_t)(1e9 / hz + 0.5);
+  p->next_ns = now_ns() + p->period_ns;
+  p->last_wake_ns = 0;
+  p->frames = 0;
+  p->skipped = 0;
+  hist_reset(&p->interval);
+  hist_reset(&p->lateness);
+}
+
+// Missed whole periods: drop those frames but stay on the grid
+static int catch_up(Pacer *p, int64_t now) {
+  if (now - p->next_ns < p->period_ns)
+    return 0;
+  int skipped = (int)((now - p->next_ns) / p->period_ns);
+  p->next_ns += skipped * p->period_ns;
+  p->skipped += skipped;
+  return skipped;
+}
+
+int64_t pacer_deadline(Pacer *p) {
+  catch_up(p, now_ns());
+  return p->next_ns;
+}
+
+void pacer_tick(Pacer *p) {
+  int64_t now = now_ns();
+
+  hist_record(&p->lateness, now > p->next_ns ? now - p->next_ns : 0);
+  if (p->last_wake_ns)
+    hist_record(&p->interval, now - p->last_wake_ns);
+  p->last_wake_ns = now;
+  p->next_ns += p->period_ns;
+  p->frames++;
+}
+
+int pacer_wait(Pacer *p) {
+  int skipped = catch_up(p, now_ns());
+
+  struct timespec deadline = {p->next_ns / 1000000000,
+                              p->next_ns % 1000000000};
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) ==
+         EINTR)
+    ;
+  pacer_tick(p);
+  return skipped;
+}
+
+void pacer_report(const Pacer *p, FILE *out) {
+  const Histogram *iv = &p->interval;
+  const Histogram *late = &p->lateness;
+
+  fprintf(out, "frames: %llu (dropped %llu), target interval %.3f ms\n",
+          (unsigned long long)p->frames, (unsigned long long)p->skipped,
+          p->period_ns / 1e6);
+  if (iv->total == 0)
+    return;
+  fprintf(out,
+          "frame interval: min %.3f ms, mean %.3f ms, p99 %.3f ms, "
+          "max %.3f ms\n",
+          iv->min / 1e6, hist_mean(iv) / 1e6,
+          hist_percentile(iv, 0.99) / 1e6, iv->max / 1e6);
+  fprintf(out, "deadline lateness: mean %.3f ms, p99 %.3f ms\n",
+          hist_mean(late) / 1e6, hist_percentile(late, 0.99) / 1e6);
+}
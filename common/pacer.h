@@ -0,0 +1,43 @@
+#ifndef COMMON_PACER_H
+#define COMMON_PACER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+
+// Fixed-rate frame pacing against absolute deadlines on CLOCK_MONOTONIC.
+//
+// Deadlines sit on a fixed grid (start + k * period), so time spent on
+// physics and rendering is absorbed instead of adding to every frame, and
+// the rate does not drift. A frame that runs late by less than a period
+// starts immediately to catch up; one that misses whole periods drops those
+// frames and rejoins the grid at the next deadline.
+typedef struct {
+  int64_t period_ns;
+  int64_t next_ns;      // absolute deadline of the next frame
+  int64_t last_wake_ns; // 0 until the first frame
+  uint64_t frames;
+  uint64_t skipped;
+  Histogram interval; // time between successive frame starts
+  Histogram lateness; // how far past its deadline each frame started
+} Pacer;
+
+void pacer_init(Pacer *p, double hz);
+
+// Sleeps until the next deadline. Returns the number of frames dropped
+// because the caller fell behind (usually 0).
+int pacer_wait(Pacer *p);
+
+// pacer_wait() in two halves, for callers that block on something else as
+// well (see common/eventloop.h). pacer_deadline() drops any whole periods
+// already missed and returns the absolute CLOCK_MONOTONIC time of the next
+// frame in ns; it may be called repeatedly while waiting. pacer_tick() marks
+// the start of that frame once the deadline has passed.
+int64_t pacer_deadline(Pacer *p);
+void pacer_tick(Pacer *p);
+
+// Prints frame count, drops and min/mean/p99/max frame-interval jitter
+void pacer_report(const Pacer *p, FILE *out);
+
+#endif
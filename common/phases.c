@@ -0,0 +1,71 @@
+#include "phases.h"
+
+#include <time.h>
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void phases_init(PhaseTimer *pt, const char *const *names, int count) {
+  pt->count = count < PHASES_MAX ? count : PHASES_MAX;
+  pt->names = names;
+  for (int i = 0; i < PHASES_MAX; i++) {
+    pt->pending[i] = 0;
+    hist_reset(&pt->hist[i]);
+  }
+  pt->mark_ns = now_ns();
+}
+
+void phases_lap(PhaseTimer *pt, int phase) {
+  int64_t now = now_ns();
+  pt->pending[phase] += now - pt->mark_ns;
+  pt->mark_ns = now;
+}
+
+void phases_commit(PhaseTimer *pt) {
+  for (int i = 0; i < pt->count; i++) {
+    hist_record(&pt->hist[i], (uint64_t)pt->pending[i]);
+    pt->pending[i] = 0;
+  }
+}
+
+void phases_draw(const PhaseTimer *pt, Display *display, Drawable drawable,
+                 GC gc, int x, int y, int line_height) {
+  char text[64];
+  int n = snprintf(text, sizeof(text), "%-8s %8s %8s", "phase", "p50 ms",
+                   "p99 ms");
+  XDrawString(display, drawable, gc, x, y, text, n);
+  for (int i = 0; i < pt->count; i++) {
+    const Histogram *h = &pt->hist[i];
+    n = snprintf(text, sizeof(text), "%-8s %8.3f %8.3f", pt->names[i],
+                 hist_percentile(h, 0.5) / 1e6, hist_percentile(h, 0.99) / 1e6);
+    XDrawString(display, drawable, gc, x, y + (i + 1) * line_height, text, n);
+  }
+}
+
+void phases_report(const PhaseTimer *pt, FILE *out) {
+  for (int i = 0; i < pt->count; i++) {
+    const Histogram *h = &pt->hist[i];
+    fprintf(out, "phase %-8s p50 %.3f ms, p99 %.3f ms, mean %.3f ms\n",
+            pt->names[i], hist_percentile(h, 0.5) / 1e6,
+            hist_percentile(h, 0.99) / 1e6, hist_mean(h) / 1e6);
+  }
+}
+
+void phases_write_csv(const PhaseTimer *pt, FILE *out) {
+  fprintf(out, "phase,bucket_min_ns,bucket_max_ns,count\n");
+  for (int i = 0; i < pt->count; i++) {
+    for (int b = 0; b < HIST_BUCKETS; b++) {
+      if (!pt->hist[i].counts[b])
+        continue;
+      uint64_t max = b + 1 < HIST_BUCKETS ? hist_bucket_floor(b + 1) - 1
+                                          : UINT64_MAX;
+      fprintf(out, "%s,%llu,%llu,%llu\n", pt->names[i],
+              (unsigned long long)hist_bucket_floor(b),
+              (unsigned long long)max,
+              (unsigned long long)pt->hist[i].counts[b]);
+    }
+  }
+}
@@ -0,0 +1,41 @@
+#ifndef COMMON_PHASES_H
+#define COMMON_PHASES_H
+
+#include <X11/Xlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+
+// Per-phase frame timing. The loop calls phases_lap() as each phase ends,
+// which charges the time since the previous lap to that phase. A phase may
+// run several times in one frame (the event drain does, once per wakeup);
+// phases_commit() then records each phase's total for the frame in its own
+// histogram. Nothing is allocated after phases_init().
+#define PHASES_MAX 8
+
+typedef struct {
+  int count;
+  const char *const *names;
+  int64_t mark_ns; // end of the last lap
+  int64_t pending[PHASES_MAX];
+  Histogram hist[PHASES_MAX];
+} PhaseTimer;
+
+// names must outlive the timer; at most PHASES_MAX of them
+void phases_init(PhaseTimer *pt, const char *const *names, int count);
+void phases_lap(PhaseTimer *pt, int phase);
+void phases_commit(PhaseTimer *pt);
+
+// Draws a header and one line of p50 and p99 per phase in the GC's font and
+// foreground. (x, y) is the first line's baseline.
+void phases_draw(const PhaseTimer *pt, Display *display, Drawable drawable,
+                 GC gc, int x, int y, int line_height);
+
+// p50, p99 and mean per phase, one line each
+void phases_report(const PhaseTimer *pt, FILE *out);
+
+// Every non-empty bucket as phase,bucket_min_ns,bucket_max_ns,count
+void phases_write_csv(const PhaseTimer *pt, FILE *out);
+
+#endif
@@ -0,0 +1,105 @@
+#include "present.h"
+
+#include <time.h>
+
+static int dbe_failed;
+
+static int dbe_error_handler(Display *display, XErrorEvent *event) {
+  (void)display;
+  (void)event;
+  dbe_failed = 1;
+  return 0;
+}
+
+static int64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Whether DBE can double-buffer windows of the given visual
+static int visual_supported(Display *display, Window window) {
+  XWindowAttributes attrs;
+  int screens = 1;
+  int found = 0;
+
+  if (!XGetWindowAttributes(display, window, &attrs))
+    return 0;
+  Drawable root = attrs.root;
+  XdbeScreenVisualInfo *info = XdbeGetVisualInfo(display, &root, &screens);
+  if (!info)
+    return 0;
+  VisualID id = XVisualIDFromVisual(attrs.visual);
+  for (int i = 0; i < info->count && !found; i++)
+    found = info->visinfo[i].visual == id;
+  XdbeFreeVisualInfo(info);
+  return found;
+}
+
+int present_init(Presenter *p, Display *display, Window window) {
+  int major, minor;
+
+  *p = (Presenter){.display = display, .window = window, .target = window};
+  hist_reset(&p->swap_wait);
+  if (!XdbeQueryExtension(display, &major, &minor) ||
+      !visual_supported(display, window))
+    return 0;
+
+  // Allocation errors arrive asynchronously
+  dbe_failed = 0;
+  XSync(display, False);
+  int (*old_handler)(Display *, XErrorEvent *) =
+      XSetErrorHandler(dbe_error_handler);
+  XdbeBackBuffer back =
+      XdbeAllocateBackBufferName(display, window, XdbeBackground);
+  XSync(display, False);
+  XSetErrorHandler(old_handler);
+  if (dbe_failed)
+    return 0;
+
+  p->back = back;
+  p->target = back;
+  // A new back buffer's contents are undefined; after two swaps both
+  // buffers hold the window background
+  for (int i = 0; i < 2; i++) {
+    XdbeSwapInfo swap = {window, XdbeBackground};
+    XdbeSwapBuffers(display, &swap, 1);
+  }
+  XSync(display, False);
+  return 1;
+}
+
+void present_destroy(Presenter *p) {
+  if (p->back != None)
+    XdbeDeallocateBackBufferName(p->display, p->back);
+  p->back = None;
+  p->target = p->window;
+}
+
+void present_begin(Presenter *p) {
+  if (p->back == None)
+    XClearWindow(p->display, p->window);
+}
+
+void present_swap(Presenter *p) {
+  if (p->back == None) {
+    XFlush(p->display);
+    return;
+  }
+  XdbeSwapInfo swap = {p->window, XdbeBackground};
+  int64_t start = now_ns();
+  XdbeSwapBuffers(p->display, &swap, 1);
+  XSync(p->display, False);
+  hist_record(&p->swap_wait, now_ns() - start);
+  p->swaps++;
+}
+
+void present_report(const Presenter *p, FILE *out) {
+  if (p->back == None && p->swaps == 0) {
+    fprintf(out, "present: drawing to the window (no DBE)\n");
+    return;
+  }
+  fprintf(out, "present: DBE, %llu swaps, wait mean %.3f ms, p99 %.3f ms\n",
+          (unsigned long long)p->swaps, hist_mean(&p->swap_wait) / 1e6,
+          hist_percentile(&p->swap_wait, 0.99) / 1e6);
+}
@@ -0,0 +1,48 @@
+#ifndef COMMON_PRESENT_H
+#define COMMON_PRESENT_H
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xdbe.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "histogram.h"
+
+// Tear-free presentation through the Double Buffer Extension (DBE).
+//
+// Frames are drawn into the window's back buffer (Presenter.target) and
+// shown whole by present_swap(), so the window never shows a half-drawn or
+// freshly cleared frame. After each swap the back buffer holds the window
+// background, so callers that used XClearWindow() need no clear at all.
+//
+// present_swap() returns only once the server has carried out the swap. On
+// servers that sync swaps to vertical retrace that is the display's
+// completion signal: the loop cannot queue frames ahead of the display, and
+// the time spent waiting is recorded. The frame pacer stays in charge of the
+// rate, as DBE itself does not say when the frame reached the screen.
+//
+// Without DBE (or with a visual it cannot double-buffer) target is the
+// window itself and present_begin() falls back to XClearWindow().
+typedef struct {
+  Display *display;
+  Window window;
+  XdbeBackBuffer back; // None without DBE
+  Drawable target;     // where to draw the frame
+  uint64_t swaps;
+  Histogram swap_wait; // ns from the swap request to its completion
+} Presenter;
+
+// Returns 1 if frames are double-buffered, 0 if drawing goes to the window
+int present_init(Presenter *p, Display *display, Window window);
+void present_destroy(Presenter *p);
+
+// Prepares target for a new frame
+void present_begin(Presenter *p);
+
+// Shows the frame drawn into target and waits for the swap to complete
+void present_swap(Presenter *p);
+
+// Prints the backend, the swap count and the swap-completion wait
+void present_report(const Presenter *p, FILE *out);
+
+#endif
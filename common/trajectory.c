@@ -0,0 +1,178 @@
+#define _GNU_SOURCE // mremap
+#include "trajectory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The recording file and its mapping grow by this much at a time
+#define TRAJ_GROW_BYTES (64u << 20)
+
+// Extend the file and mapping to at least size bytes
+static int grow(Trajectory *t, size_t size) {
+  size_t new_size = t->map_size;
+  while (new_size < size)
+    new_size += TRAJ_GROW_BYTES;
+  if (ftruncate(t->fd, new_size) < 0)
+    return 0;
+  void *map = mremap(t->map, t->map_size, new_size, MREMAP_MAYMOVE);
+  if (map == MAP_FAILED)
+    return 0;
+  t->map = map;
+  t->map_size = new_size;
+  t->header = map;
+  return 1;
+}
+
+int traj_create(Trajectory *t, const char *path, uint32_t ball_count,
+                uint32_t keyframe_interval) {
+  *t = (Trajectory){.fd = -1, .writable = 1};
+  t->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (t->fd < 0)
+    return 0;
+  if (ftruncate(t->fd, TRAJ_GROW_BYTES) < 0)
+    goto fail;
+  t->map = mmap(NULL, TRAJ_GROW_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED,
+                t->fd, 0);
+  if (t->map == MAP_FAILED)
+    goto fail;
+  t->map_size = TRAJ_GROW_BYTES;
+  t->header = (TrajHeader *)t->map;
+  *t->header = (TrajHeader){
+      .version = TRAJ_VERSION,
+      .ball_count = ball_count,
+      .frame_size = sizeof(TrajFrame) + ball_count * sizeof(TrajBall),
+      .keyframe_interval = keyframe_interval ? keyframe_interval : 1,
+  };
+  memcpy(t->header->magic, TRAJ_MAGIC, sizeof(t->header->magic));
+  return 1;
+
+fail:
+  close(t->fd);
+  t->fd = -1;
+  return 0;
+}
+
+int traj_open(Trajectory *t, const char *path) {
+  struct stat st;
+
+  *t = (Trajectory){.fd = -1};
+  t->fd = open(path, O_RDONLY);
+  if (t->fd < 0)
+    return 0;
+  if (fstat(t->fd, &st) < 0)
+    goto fail;
+  if ((size_t)st.st_size < sizeof(TrajHeader)) {
+    errno = EINVAL;
+    goto fail;
+  }
+  t->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, t->fd, 0);
+  if (t->map == MAP_FAILED)
+    goto fail;
+  t->map_size = st.st_size;
+  t->header = (TrajHeader *)t->map;
+
+  const TrajHeader *h = t->header;
+  size_t frames_end = sizeof(TrajHeader) + h->frame_count * h->frame_size;
+  if (memcmp(h->magic, TRAJ_MAGIC, sizeof(h->magic)) != 0 ||
+      h->version != TRAJ_VERSION ||
+      h->frame_size != sizeof(TrajFrame) + h->ball_count * sizeof(TrajBall) ||
+      h->keyframe_interval == 0 || frames_end > t->map_size ||
+      (h->index_offset &&
+       (h->index_offset < frames_end ||
+        h->index_offset + h->index_count * sizeof(TrajKeyframe) >
+            t->map_size))) {
+    munmap(t->map, t->map_size);
+    errno = EINVAL;
+    goto fail;
+  }
+  // Frames are visited in any order during playback
+  madvise(t->map, t->map_size, MADV_RANDOM);
+  return 1;
+
+fail:
+  close(t->fd);
+  t->fd = -1;
+  return 0;
+}
+
+TrajFrame *traj_append(Trajectory *t) {
+  TrajHeader *h = t->header;
+  size_t end = sizeof(TrajHeader) + (h->frame_count + 1) * h->frame_size;
+  if (end > t->map_size && !grow(t, end))
+    return NULL;
+
+  h = t->header;
+  TrajFrame *frame = traj_frame(t, h->frame_count);
+  memset(frame, 0, h->frame_size);
+  frame->frame = h->frame_count++;
+  return frame;
+}
+
+int traj_close(Trajectory *t) {
+  int ok = 1;
+
+  if (t->writable) {
+    TrajHeader *h = t->header;
+    size_t frames_end = sizeof(TrajHeader) + h->frame_count * h->frame_size;
+    uint64_t count =
+        (h->frame_count + h->keyframe_interval - 1) / h->keyframe_interval;
+    size_t end = frames_end + count * sizeof(TrajKeyframe);
+
+    if (end <= t->map_size || grow(t, end)) {
+      h = t->header;
+      TrajKeyframe *index = (TrajKeyframe *)(t->map + frames_end);
+      for (uint64_t k = 0; k < count; k++) {
+        uint64_t frame = k * h->keyframe_interval;
+        index[k] = (TrajKeyframe){frame, traj_frame(t, frame)->time};
+      }
+      h->index_offset = frames_end;
+      h->index_count = count;
+    } else {
+      end = frames_end;
+      ok = 0;
+    }
+    // Drop the unused tail of the last growth step
+    if (ftruncate(t->fd, end) < 0)
+      ok = 0;
+  }
+  munmap(t->map, t->map_size);
+  close(t->fd);
+  t->fd = -1;
+  return ok;
+}
+
+uint64_t traj_find_time(const Trajectory *t, double time) {
+  const TrajHeader *h = t->header;
+  uint64_t lo = 0, hi = h->frame_count;
+
+  if (h->frame_count == 0)
+    return 0;
+  // Narrow the search to one keyframe interval using the index
+  if (h->index_offset) {
+    const TrajKeyframe *index =
+        (const TrajKeyframe *)(t->map + h->index_offset);
+    uint64_t klo = 0, khi = h->index_count;
+    while (khi - klo > 1) {
+      uint64_t mid = klo + (khi - klo) / 2;
+      if (index[mid].time <= time)
+        klo = mid;
+      else
+        khi = mid;
+    }
+    lo = index[klo].frame;
+    if (khi < h->index_count)
+      hi = index[khi].frame;
+  }
+  while (hi - lo > 1) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (traj_frame(t, mid)->time <= time)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
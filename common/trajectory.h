@@ -0,0 +1,94 @@
+#ifndef COMMON_TRAJECTORY_H
+#define COMMON_TRAJECTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary trajectory files, written and read through a memory mapping.
+//
+// A file is a TrajHeader followed by one fixed-size record per frame: a
+// TrajFrame and then ball_count TrajBalls. Frame i therefore sits at a fixed
+// offset and is reached in O(1) without reading anything before it. The
+// recorder grows the file and its mapping in large steps, so appending a
+// frame is a few stores into mapped memory: no heap growth and no stdio.
+//
+// Every keyframe_interval-th frame is a keyframe. Closing a recording
+// appends an index of the keyframes' times after the frames, which lets a
+// reader map a time to a frame without touching every record. A recording
+// that was never closed has no index but its frames are still readable.
+
+#define TRAJ_MAGIC "BHXTRAJ"
+#define TRAJ_VERSION 1
+
+// Contact flags, per ball and ORed together per frame
+enum {
+  TRAJ_WALL_CONTACT = 1 << 0,
+  TRAJ_BALL_CONTACT = 1 << 1,
+};
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t ball_count;
+  uint32_t frame_size; // bytes per frame record, balls included
+  uint32_t keyframe_interval;
+  uint64_t frame_count;
+  uint64_t index_offset; // 0 if the recording was not closed
+  uint64_t index_count;
+  uint8_t reserved[16];
+} TrajHeader;
+
+typedef struct {
+  double time;
+  double angle; // hexagon rotation
+  uint64_t frame;
+  uint32_t flags;
+  uint32_t reserved;
+} TrajFrame;
+
+typedef struct {
+  double x, y;
+  double vx, vy;
+  uint32_t flags;
+  uint32_t reserved;
+} TrajBall;
+
+typedef struct {
+  uint64_t frame;
+  double time;
+} TrajKeyframe;
+
+typedef struct {
+  int fd;
+  int writable;
+  uint8_t *map;
+  size_t map_size; // bytes mapped; while recording also the file size
+  TrajHeader *header;
+} Trajectory;
+
+// Both return 0 on failure with errno set (EINVAL for a malformed file)
+int traj_create(Trajectory *t, const char *path, uint32_t ball_count,
+                uint32_t keyframe_interval);
+int traj_open(Trajectory *t, const char *path);
+
+// Writes the keyframe index when recording, then unmaps and closes.
+// Returns 0 if the index could not be written.
+int traj_close(Trajectory *t);
+
+// Returns the next frame record, with its number filled in and everything
+// else zeroed, or NULL if the file cannot grow
+TrajFrame *traj_append(Trajectory *t);
+
+static inline TrajFrame *traj_frame(const Trajectory *t, uint64_t i) {
+  return (TrajFrame *)(t->map + sizeof(TrajHeader) +
+                       i * t->header->frame_size);
+}
+
+static inline TrajBall *traj_balls(TrajFrame *frame) {
+  return (TrajBall *)(frame + 1);
+}
+
+// Last frame whose time is <= time (0 if time precedes the recording)
+uint64_t traj_find_time(const Trajectory *t, double time);
+
+#endif
@@ -0,0 +1,47 @@
+#include "triplebuf.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// Set in middle when the published slot has not been read yet
+#define TB_FRESH 4u
+
+int tb_init(TripleBuffer *tb, size_t slot_size) {
+  // Every slot is aligned like the first
+  size_t align = _Alignof(max_align_t);
+  slot_size = (slot_size + align - 1) / align * align;
+  *tb = (TripleBuffer){
+      .slots = calloc(3, slot_size),
+      .slot_size = slot_size,
+      .write_slot = 0,
+      .read_slot = 1,
+  };
+  atomic_init(&tb->middle, 2);
+  atomic_init(&tb->published, 0);
+  return tb->slots != NULL;
+}
+
+void tb_free(TripleBuffer *tb) {
+  free(tb->slots);
+  tb->slots = NULL;
+}
+
+void tb_publish(TripleBuffer *tb) {
+  // Release makes the slot's contents visible with the exchange
+  unsigned old = atomic_exchange_explicit(
+      &tb->middle, tb->write_slot | TB_FRESH, memory_order_acq_rel);
+  tb->write_slot = old & ~TB_FRESH;
+  atomic_fetch_add_explicit(&tb->published, 1, memory_order_relaxed);
+}
+
+const void *tb_read(TripleBuffer *tb, int *fresh) {
+  *fresh = 0;
+  if (atomic_load_explicit(&tb->middle, memory_order_relaxed) & TB_FRESH) {
+    unsigned old = atomic_exchange_explicit(&tb->middle, tb->read_slot,
+                                            memory_order_acq_rel);
+    tb->read_slot = old & ~TB_FRESH;
+    tb->consumed++;
+    *fresh = 1;
+  }
+  return tb->consumed ? tb->slots + tb->read_slot * tb->slot_size : NULL;
+}
@@ -0,0 +1,44 @@
+#ifndef COMMON_TRIPLEBUF_H
+#define COMMON_TRIPLEBUF_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Wait-free triple buffer handing fixed-size snapshots from one producer
+// thread to one consumer thread.
+//
+// The writer owns one slot and the reader another; the third is the most
+// recently published snapshot. Publishing swaps the writer's slot with that
+// one, and reading swaps it with the reader's if something new was
+// published since. Both sides finish in one atomic exchange and never wait
+// for each other: the writer overwrites snapshots the reader never got to,
+// and the reader keeps its last snapshot until a newer one arrives.
+typedef struct {
+  unsigned char *slots; // three slots of slot_size bytes
+  size_t slot_size;
+  _Atomic unsigned middle; // published slot, ORed with TB_FRESH if unread
+  unsigned write_slot;     // owned by the writer
+  unsigned read_slot;      // owned by the reader
+  _Atomic uint64_t published;
+  uint64_t consumed; // snapshots the reader picked up
+} TripleBuffer;
+
+// Returns 0 if the slots cannot be allocated. They start zeroed, and the
+// reader sees slot contents only after the first publish.
+int tb_init(TripleBuffer *tb, size_t slot_size);
+void tb_free(TripleBuffer *tb);
+
+// Writer: fill the slot returned by tb_write_slot(), then publish it. The
+// next call to tb_write_slot() returns a different slot.
+static inline void *tb_write_slot(TripleBuffer *tb) {
+  return tb->slots + tb->write_slot * tb->slot_size;
+}
+void tb_publish(TripleBuffer *tb);
+
+// Reader: returns the newest published snapshot, or NULL if nothing has
+// been published yet. *fresh is set to 1 if it was not returned before.
+// The snapshot stays valid until the next call.
+const void *tb_read(TripleBuffer *tb, int *fresh);
+
+#endif
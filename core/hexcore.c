@@ -0,0 +1,606 @@
+#include "hexcore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const integrator_names[] = {
+    [HC_INTEGRATE_EULER] = "euler",
+    [HC_INTEGRATE_VERLET] = "verlet",
+    [HC_INTEGRATE_RK4] = "rk4",
+};
+
+const char *hc_integrator_name(HcIntegrator integrator) {
+  return integrator_names[integrator];
+}
+
+int hc_integrator_parse(const char *name, HcIntegrator *integrator) {
+  int count = (int)(sizeof(integrator_names) / sizeof(*integrator_names));
+  for (int i = 0; i < count; i++) {
+    if (strcmp(name, integrator_names[i]) == 0) {
+      *integrator = (HcIntegrator)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int hc_shape_init(HcShape *shape, int sides, Vec2 center, double radius,
+                  double omega) {
+  double *block = malloc(8 * (size_t)sides * sizeof(double));
+  if (!block)
+    return 0;
+
+  *shape = (HcShape){
+      .sides = sides,
+      .center = center,
+      .radius = radius,
+      .omega = omega,
+      .cos_half = cos(M_PI / sides),
+      .sin_half = sin(M_PI / sides),
+      .edge_length = 2 * radius * sin(M_PI / sides),
+      .unit_x = block,
+      .unit_y = block + sides,
+      .vx = block + 2 * sides,
+      .vy = block + 3 * sides,
+      .nx = block + 4 * sides,
+      .ny = block + 5 * sides,
+      .tx = block + 6 * sides,
+      .ty = block + 7 * sides,
+  };
+  for (int i = 0; i < sides; i++) {
+    double theta = 2 * M_PI * i / sides;
+    shape->unit_x[i] = cos(theta);
+    shape->unit_y[i] = sin(theta);
+  }
+  hc_shape_update(shape, 0.0);
+  return 1;
+}
+
+void hc_shape_free(HcShape *shape) {
+  free(shape->unit_x);
+  shape->unit_x = NULL;
+}
+
+void hc_shape_turn(HcShape *shape, double angle) {
+  shape->angle = angle;
+  shape->cos_angle = cos(angle);
+  shape->sin_angle = sin(angle);
+}
+
+void hc_shape_update(HcShape *shape, double angle) {
+  hc_shape_turn(shape, angle);
+  const double c = shape->cos_angle, s = shape->sin_angle;
+  const double r = shape->radius;
+  const double cx = shape->center.x, cy = shape->center.y;
+  // The outward normal of edge i points at its midpoint, which lies half a
+  // central angle past vertex i, so no per-edge sqrt or trig is needed
+  const double hc = shape->cos_half, hs = shape->sin_half;
+
+  for (int i = 0; i < shape->sides; i++) {
+    double ux = shape->unit_x[i] * c - shape->unit_y[i] * s;
+    double uy = shape->unit_x[i] * s + shape->unit_y[i] * c;
+    double mx = ux * hc - uy * hs;
+    double my = ux * hs + uy * hc;
+    shape->vx[i] = cx + r * ux;
+    shape->vy[i] = cy + r * uy;
+    shape->nx[i] = mx;
+    shape->ny[i] = my;
+    shape->tx[i] = -my;
+    shape->ty[i] = mx;
+  }
+}
+
+// One edge: its start vertex, unit normal and unit direction
+typedef struct {
+  double vx, vy, nx, ny, tx, ty;
+} Edge;
+
+static inline Edge stored_edge(const HcShape *shape, int i) {
+  return (Edge){shape->vx[i], shape->vy[i], shape->nx[i],
+                shape->ny[i], shape->tx[i], shape->ty[i]};
+}
+
+// Edge i at the shape's current angle, computed exactly as
+// hc_shape_update() would store it
+static inline Edge turned_edge(const HcShape *shape, int i) {
+  const double c = shape->cos_angle, s = shape->sin_angle;
+  const double hc = shape->cos_half, hs = shape->sin_half;
+  double ux = shape->unit_x[i] * c - shape->unit_y[i] * s;
+  double uy = shape->unit_x[i] * s + shape->unit_y[i] * c;
+  double mx = ux * hc - uy * hs;
+  double my = ux * hs + uy * hc;
+  return (Edge){shape->center.x + shape->radius * ux,
+                shape->center.y + shape->radius * uy, mx, my, -my, mx};
+}
+
+static inline Edge lookup_edge(const HcPolicy *policy, const HcShape *shape,
+                               int i) {
+  return policy->lookup == HC_LOOKUP_SECTOR ? turned_edge(shape, i)
+                                            : stored_edge(shape, i);
+}
+
+// Contact of a ball with one edge: the normal points from the wall towards
+// the side the ball is pushed to, dist is the ball centre's distance along it
+typedef struct {
+  Vec2 normal;
+  Vec2 point; // contact point on the edge (line)
+  double dist;
+} Contact;
+
+static int find_contact(const HcPolicy *policy, const HcShape *shape,
+                        const Edge *e, const HcBall *ball, double radius,
+                        Contact *c) {
+  double fx = ball->x - e->vx;
+  double fy = ball->y - e->vy;
+
+  if (policy->test == HC_TEST_CLOSEST) {
+    double s = fx * e->tx + fy * e->ty;
+    s = fmax(0.0, fmin(shape->edge_length, s));
+    Vec2 closest = {e->vx + s * e->tx, e->vy + s * e->ty};
+    Vec2 to_ball = {ball->x - closest.x, ball->y - closest.y};
+    double dist = vec2_length(to_ball);
+    if (dist >= radius || dist == 0)
+      return 0;
+    c->normal = vec2_scale(to_ball, 1.0 / dist);
+    c->point = closest;
+    c->dist = dist;
+    return 1;
+  }
+
+  double nx = e->nx, ny = e->ny;
+  double dist = fx * nx + fy * ny;
+  switch (policy->test) {
+  case HC_TEST_LINE:
+    if (!(dist < radius))
+      return 0;
+    break;
+  case HC_TEST_FOOT: {
+    double along = fx * e->tx + fy * e->ty;
+    if (along < 0 || along > shape->edge_length || !(dist < radius))
+      return 0;
+    break;
+  }
+  case HC_TEST_LINE_ABS:
+    if (!(fabs(dist) < radius))
+      return 0;
+    break;
+  default:
+    return 0;
+  }
+  c->normal = (Vec2){nx, ny};
+  c->point = (Vec2){ball->x - nx * dist, ball->y - ny * dist};
+  c->dist = dist;
+  return 1;
+}
+
+// Returns 0 if the ball was moved but its velocity was left alone
+static int apply_contact(const HcPolicy *policy, const HcShape *shape,
+                         const Contact *c, HcBall *ball, double radius) {
+  Vec2 n = c->normal;
+
+  switch (policy->push) {
+  case HC_PUSH_OUT:
+    ball->x += n.x * (radius - c->dist);
+    ball->y += n.y * (radius - c->dist);
+    break;
+  case HC_PUSH_TO_LINE:
+    ball->x -= n.x * c->dist;
+    ball->y -= n.y * c->dist;
+    break;
+  case HC_PUSH_NONE:
+    break;
+  }
+
+  if (policy->response == HC_RESPONSE_SCALE) {
+    double v_dot_n = ball->vx * n.x + ball->vy * n.y;
+    double vnx = n.x * v_dot_n, vny = n.y * v_dot_n;
+    double keep = policy->tangent_keep;
+    ball->vx = vnx * -policy->restitution + (ball->vx - vnx) * keep;
+    ball->vy = vny * -policy->restitution + (ball->vy - vny) * keep;
+    return 1;
+  }
+
+  // Velocity relative to the wall, which moves with the rotation
+  double wx = -shape->omega * (c->point.y - shape->center.y);
+  double wy = shape->omega * (c->point.x - shape->center.x);
+  double rx = ball->vx - wx, ry = ball->vy - wy;
+  double v_n = rx * n.x + ry * n.y;
+  if (v_n >= 0)
+    return 0;
+  double j_n = -(1 + policy->restitution) * v_n;
+  Vec2 t = {-n.y, n.x};
+  double v_t = rx * t.x + ry * t.y;
+  double j_t = -v_t;
+  double mu_jn = policy->mu * fabs(j_n);
+  if (fabs(j_t) > mu_jn)
+    j_t = v_t > 0 ? -mu_jn : mu_jn;
+  ball->vx += j_n * n.x + j_t * t.x;
+  ball->vy += j_n * n.y + j_t * t.y;
+  return 1;
+}
+
+int hc_collide_edge(const HcPolicy *policy, const HcShape *shape, int edge,
+                    HcBall *ball, double radius) {
+  Contact c;
+  Edge e = lookup_edge(policy, shape, edge);
+  if (!find_contact(policy, shape, &e, ball, radius, &c))
+    return 0;
+  return apply_contact(policy, shape, &c, ball, radius);
+}
+
+// Edges the ball may touch, as up to two ascending index ranges [lo, hi]
+// so they are visited in the same order as a loop over every edge. Returns
+// the number of ranges.
+//
+// HC_TEST_CLOSEST and HC_TEST_LINE_ABS need the centre within radius of the
+// edge's line, p . n > apothem - radius, so edge i is only reachable if its
+// normal lies within acos((apothem - radius) / |p|) of the ball's direction
+// from the centre. The one-sided tests also accept every ball behind the
+// line, so they always get every edge. Normal i points at
+// angle + 2*pi*(i + 1/2)/sides, which turns that cone into a window of edge
+// indices around the ball's sector.
+static int edge_ranges(const HcPolicy *policy, const HcShape *shape,
+                       const HcBall *ball, double radius, int ranges[2][2]) {
+  const int n = shape->sides;
+
+  ranges[0][0] = 0;
+  ranges[0][1] = n - 1;
+  if (policy->lookup != HC_LOOKUP_SECTOR ||
+      (policy->test != HC_TEST_CLOSEST && policy->test != HC_TEST_LINE_ABS))
+    return 1;
+
+  double px = ball->x - shape->center.x, py = ball->y - shape->center.y;
+  double dist = sqrt(px * px + py * py);
+  double reach = shape->radius * shape->cos_half - radius;
+  if (dist <= reach)
+    return 0;
+  if (reach <= -dist)
+    return 1;
+
+  double step = 2 * M_PI / n;
+  double spread = acos(reach / dist) / step;
+  double sector = remainder(atan2(py, px) - shape->angle, 2 * M_PI) / step;
+  // One extra edge either side absorbs rounding in the angles
+  int lo = (int)floor(sector - 0.5 - spread) - 1;
+  int hi = (int)ceil(sector - 0.5 + spread) + 1;
+  if (hi - lo + 1 >= n)
+    return 1;
+
+  // Wrap the window into [0, n); past the last edge it continues at 0
+  int first = ((lo % n) + n) % n;
+  int last = first + (hi - lo);
+  if (last < n) {
+    ranges[0][0] = first, ranges[0][1] = last;
+    return 1;
+  }
+  ranges[0][0] = 0, ranges[0][1] = last - n;
+  ranges[1][0] = first, ranges[1][1] = n - 1;
+  return 2;
+}
+
+int hc_collide(const HcPolicy *policy, const HcShape *shape, HcBall *ball,
+               double radius) {
+  int ranges[2][2];
+  int count = edge_ranges(policy, shape, ball, radius, ranges);
+  int contacts = 0;
+  for (int r = 0; r < count; r++) {
+    for (int i = ranges[r][0]; i <= ranges[r][1]; i++) {
+      Contact c;
+      Edge e = lookup_edge(policy, shape, i);
+      if (!find_contact(policy, shape, &e, ball, radius, &c))
+        continue;
+      contacts += apply_contact(policy, shape, &c, ball, radius);
+      if (policy->first_hit_only)
+        return contacts;
+    }
+  }
+  return contacts;
+}
+
+double hc_penetration(const HcPolicy *policy, const HcShape *shape,
+                      const HcBall *ball, double radius) {
+  int ranges[2][2];
+  int count = edge_ranges(policy, shape, ball, radius, ranges);
+  double depth = 0;
+  for (int r = 0; r < count; r++) {
+    for (int i = ranges[r][0]; i <= ranges[r][1]; i++) {
+      Contact c;
+      Edge e = lookup_edge(policy, shape, i);
+      if (find_contact(policy, shape, &e, ball, radius, &c))
+        depth = fmax(depth, radius - c.dist);
+    }
+  }
+  return depth;
+}
+
+// Limits of hc_sweep(): impacts resolved per step, and root-finding
+// iterations spent on each time of impact
+#define SWEEP_MAX_IMPACTS 8
+#define SWEEP_MAX_ITERATIONS 64
+
+// A ball moving in a straight line from p0 (relative to the centre of the
+// shape) at time t0 with velocity v, against one edge line that rotates so
+// that its normal is (nx, ny) at the end of the step, time dt
+typedef struct {
+  const HcShape *shape;
+  double limit; // largest distance of the centre along the normal
+  double nx, ny;
+  Vec2 p0, v;
+  double t0, dt;
+} Sweep;
+
+static Vec2 sweep_normal(const Sweep *sw, double t) {
+  double back = sw->shape->omega * (sw->dt - t);
+  double c = cos(back), s = sin(back);
+  return (Vec2){sw->nx * c + sw->ny * s, -sw->nx * s + sw->ny * c};
+}
+
+// How far the ball centre still is from touching the wall at time t
+static double sweep_gap(const Sweep *sw, double t) {
+  Vec2 n = sweep_normal(sw, t);
+  Vec2 p = vec2_add(sw->p0, vec2_scale(sw->v, t - sw->t0));
+  return sw->limit - vec2_dot(p, n);
+}
+
+// Time of impact within [a, b], given gap(a) > 0 >= gap(b). Regula falsi
+// with the Illinois modification; the result is never past the impact.
+static double sweep_solve(const Sweep *sw, double a, double fa, double b,
+                          double fb, double eps) {
+  int side = 0;
+  for (int k = 0; k < SWEEP_MAX_ITERATIONS && fa > eps; k++) {
+    double t = (a * fb - b * fa) / (fb - fa);
+    if (!(t > a && t < b))
+      t = 0.5 * (a + b);
+    double f = sweep_gap(sw, t);
+    if (f > 0) {
+      a = t;
+      fa = f;
+      if (side == 1)
+        fb *= 0.5;
+      side = 1;
+    } else {
+      b = t;
+      fb = f;
+      if (side == -1)
+        fa *= 0.5;
+      side = -1;
+    }
+    if (b - a <= 1e-12 * sw->dt)
+      break;
+  }
+  return a;
+}
+
+// Answer a ball touching the wall with outward normal n, relative to the
+// moving wall. The ball is already where it touches, so it is not pushed.
+static int answer_touch(const HcPolicy *policy, const HcShape *shape, Vec2 n,
+                        HcBall *ball, double radius) {
+  HcPolicy response = *policy;
+  response.push = HC_PUSH_NONE;
+  Contact contact = {
+      .normal = {-n.x, -n.y},
+      .point = {ball->x + n.x * radius, ball->y + n.y * radius},
+      .dist = radius,
+  };
+  if (policy->response == HC_RESPONSE_IMPULSE)
+    return apply_contact(&response, shape, &contact, ball, radius);
+
+  // Reflect in the frame of the moving wall
+  double wx = -shape->omega * (contact.point.y - shape->center.y);
+  double wy = shape->omega * (contact.point.x - shape->center.x);
+  ball->vx -= wx;
+  ball->vy -= wy;
+  int bounced = apply_contact(&response, shape, &contact, ball, radius);
+  ball->vx += wx;
+  ball->vy += wy;
+  return bounced;
+}
+
+int hc_sweep(const HcPolicy *policy, const HcShape *shape, HcBall *ball,
+             double radius, double dt) {
+  const double eps = 1e-9 * shape->radius;
+  const double omega = shape->omega;
+  int impacts = 0;
+  double t = 0;
+
+  ball->vy += policy->gravity * dt;
+
+  for (int pass = 0; pass < SWEEP_MAX_IMPACTS && t < dt; pass++) {
+    Sweep sw = {
+        .shape = shape,
+        .limit = shape->radius * cos(M_PI / shape->sides) - radius,
+        .p0 = {ball->x - shape->center.x, ball->y - shape->center.y},
+        .v = {ball->vx, ball->vy},
+        .t0 = t,
+        .dt = dt,
+    };
+    Vec2 p1 = vec2_add(sw.p0, vec2_scale(sw.v, dt - t));
+    double back = omega * (dt - t);
+    double c = cos(back), s = sin(back);
+    double toi = INFINITY;
+    int edge = -1;
+
+    // Earliest wall the centre reaches before the end of the step. A wall
+    // the ball is touching counts only while the ball closes in on it.
+    for (int i = 0; i < shape->sides; i++) {
+      sw.nx = shape->nx[i];
+      sw.ny = shape->ny[i];
+      Vec2 n0 = {sw.nx * c + sw.ny * s, -sw.nx * s + sw.ny * c};
+      double f0 = sw.limit - vec2_dot(sw.p0, n0);
+      double hit;
+      if (f0 <= eps) {
+        double closing = vec2_dot(sw.v, n0) +
+                         omega * (sw.p0.y * n0.x - sw.p0.x * n0.y);
+        if (closing <= 0)
+          continue;
+        hit = t;
+      } else {
+        double f1 = sw.limit - (p1.x * sw.nx + p1.y * sw.ny);
+        if (f1 > 0)
+          continue;
+        hit = sweep_solve(&sw, t, f0, dt, f1, eps);
+      }
+      if (hit < toi) {
+        toi = hit;
+        edge = i;
+      }
+    }
+    if (edge < 0)
+      break;
+
+    ball->x += sw.v.x * (toi - t);
+    ball->y += sw.v.y * (toi - t);
+    t = toi;
+
+    // Outward normal of the wall at the time of impact
+    sw.nx = shape->nx[edge];
+    sw.ny = shape->ny[edge];
+    impacts += answer_touch(policy, shape, sweep_normal(&sw, t), ball, radius);
+  }
+  ball->x += ball->vx * (dt - t);
+  ball->y += ball->vy * (dt - t);
+
+  return impacts + hc_collide(policy, shape, ball, radius);
+}
+
+// Limits of hc_predict_impact(): the longest step its curvature bound is
+// taken over, and the iterations spent before handing back a safe time
+#define PREDICT_MAX_STEP 0.5
+#define PREDICT_MAX_ITERATIONS 256
+
+// A ball in free flight at time t against one edge line of a turning
+// polygon: how far its centre is from touching, and how fast that changes
+typedef struct {
+  double gap, rate;
+} EdgeGap;
+
+static EdgeGap edge_gap(double limit, double angle, double omega, Vec2 p,
+                        Vec2 v) {
+  double nx = cos(angle), ny = sin(angle);
+  return (EdgeGap){limit - (p.x * nx + p.y * ny),
+                   -(v.x * nx + v.y * ny) - omega * (p.y * nx - p.x * ny)};
+}
+
+// Longest h for which gap + rate * h - curvature * h^2 / 2 stays >= 0,
+// in whichever form of the root does not cancel
+static double safe_step(EdgeGap e, double curvature) {
+  double gap = fmax(e.gap, 0.0);
+  double root = sqrt(e.rate * e.rate + 2 * curvature * gap);
+  if (e.rate >= 0)
+    return (e.rate + root) / curvature;
+  return 2 * gap / (root - e.rate);
+}
+
+int hc_predict_impact(const HcPolicy *policy, const HcShape *shape,
+                      const HcBall *ball, double radius, double *time,
+                      long *evals) {
+  const double horizon = *time;
+  const double central = 2 * M_PI / shape->sides;
+  const double limit = shape->radius * cos(M_PI / shape->sides) - radius;
+  const double eps = 1e-9 * shape->radius;
+  const double omega = shape->omega, g = policy->gravity;
+  double t = 0;
+
+  for (int k = 0; k < PREDICT_MAX_ITERATIONS && t < horizon; k++) {
+    Vec2 p = {ball->x - shape->center.x + ball->vx * t,
+              ball->y - shape->center.y + (ball->vy + 0.5 * g * t) * t};
+    Vec2 v = {ball->vx, ball->vy + g * t};
+
+    // The wall whose normal is closest in angle to the ball is the nearest,
+    // the next closest the next nearest, and every other wall is at least
+    // as far as the third. Edge i's normal points half a central angle past
+    // vertex i.
+    double first = shape->angle + omega * t + 0.5 * central;
+    double u = (atan2(p.y, p.x) - first) / central;
+    double nearest = floor(u + 0.5);
+    double side = u >= nearest ? 1 : -1;
+    EdgeGap e0 = edge_gap(limit, first + nearest * central, omega, p, v);
+    EdgeGap e1 =
+        edge_gap(limit, first + (nearest + side) * central, omega, p, v);
+    EdgeGap e2 =
+        edge_gap(limit, first + (nearest - side) * central, omega, p, v);
+    if (evals)
+      ++*evals;
+
+    // Touching a wall and closing in on it is a contact. The index counts
+    // from the unturned angle and may be negative or past the last edge.
+    double hit = e0.gap <= eps && e0.rate < 0   ? nearest
+                 : e1.gap <= eps && e1.rate < 0 ? nearest + side
+                                                : NAN;
+    if (!isnan(hit)) {
+      int edge = (int)fmod(hit, shape->sides);
+      *time = t;
+      return edge < 0 ? edge + shape->sides : edge;
+    }
+
+    // Bound the gap's second derivative over the next step: gravity along
+    // the normal, twice the Coriolis-like term and the normal's own turn,
+    // with the ball no further out than a vertex while it is inside
+    double cap = fmin(PREDICT_MAX_STEP, horizon - t);
+    double speed = hypot(v.x, v.y);
+    double curvature = fabs(g) + 2 * fabs(omega) * (speed + fabs(g) * cap) +
+                       omega * omega * shape->radius + 1e-12;
+    // The walls beyond the third close in no faster than the ball moves
+    // plus the wall at the vertex does
+    EdgeGap rest = {e2.gap, -(speed + fabs(omega) * shape->radius)};
+    double h = fmin(safe_step(e0, curvature), safe_step(e1, curvature));
+    h = fmin(h, safe_step(rest, curvature));
+    t += fmax(fmin(h, cap), 1e-12 * (1 + t));
+  }
+  *time = fmin(t, horizon);
+  return -1;
+}
+
+int hc_impact(const HcPolicy *policy, const HcShape *shape, int edge,
+              HcBall *ball, double radius) {
+  double angle = shape->angle + (edge + 0.5) * 2 * M_PI / shape->sides;
+  return answer_touch(policy, shape, (Vec2){cos(angle), sin(angle)}, ball,
+                      radius);
+}
+
+void hc_frame_init(HcFrame *frame, const HcPolicy *policy, Vec2 center,
+                   double omega, double angle, double dt) {
+  *frame = (HcFrame){
+      .center = center,
+      .omega = omega,
+      .angle = angle,
+      .dt = dt,
+      // Gravity (0, g) turned back by angle
+      .gx = policy->gravity * sin(angle),
+      .gy = policy->gravity * cos(angle),
+      .turn_cos = cos(omega * dt),
+      .turn_sin = sin(omega * dt),
+  };
+  hc_frame_sync(frame);
+}
+
+void hc_frame_sync(HcFrame *frame) {
+  frame->cos_angle = cos(frame->angle);
+  frame->sin_angle = sin(frame->angle);
+}
+
+HcBall hc_frame_from_world(const HcFrame *frame, HcBall world) {
+  const double c = frame->cos_angle, s = frame->sin_angle;
+  double x = world.x - frame->center.x, y = world.y - frame->center.y;
+  // Subtract the frame's own velocity at the ball, omega x r
+  double vx = world.vx + frame->omega * y;
+  double vy = world.vy - frame->omega * x;
+  return (HcBall){frame->center.x + x * c + y * s,
+                  frame->center.y - x * s + y * c, vx * c + vy * s,
+                  -vx * s + vy * c};
+}
+
+HcBall hc_frame_to_world(const HcFrame *frame, HcBall local) {
+  const double c = frame->cos_angle, s = frame->sin_angle;
+  Vec2 p = hc_frame_point(frame, (Vec2){local.x, local.y});
+  double x = p.x - frame->center.x, y = p.y - frame->center.y;
+  return (HcBall){p.x, p.y, local.vx * c - local.vy * s - frame->omega * y,
+                  local.vx * s + local.vy * c + frame->omega * x};
+}
+
+int hc_frame_step(const HcPolicy *policy, HcFrame *frame, const HcShape *shape,
+                  HcBall *ball, double radius) {
+  hc_frame_move(frame, &ball->x, &ball->y, &ball->vx, &ball->vy);
+  hc_frame_turn(frame);
+  return hc_collide(policy, shape, ball, radius);
+}
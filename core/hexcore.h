@@ -0,0 +1,390 @@
+#ifndef CORE_HEXCORE_H
+#define CORE_HEXCORE_H
+
+#include <math.h>
+
+// Shared physics core for the ball-in-rotating-polygon models.
+//
+// A container (HcShape) is a regular polygon whose vertices, edge normals and
+// tangents are computed once per step by hc_shape_update(), with a single
+// sin/cos. The collision kernel runs over those precomputed edges. How each
+// model detects and answers a wall contact is selected by an HcPolicy, so
+// every program runs the same kernel with its own behaviour.
+
+// --- Vector math ---
+
+typedef struct {
+  double x, y;
+} Vec2;
+
+static inline Vec2 vec2_add(Vec2 a, Vec2 b) {
+  return (Vec2){a.x + b.x, a.y + b.y};
+}
+
+static inline Vec2 vec2_sub(Vec2 a, Vec2 b) {
+  return (Vec2){a.x - b.x, a.y - b.y};
+}
+
+static inline Vec2 vec2_scale(Vec2 a, double s) {
+  return (Vec2){a.x * s, a.y * s};
+}
+
+static inline double vec2_dot(Vec2 a, Vec2 b) { return a.x * b.x + a.y * b.y; }
+static inline double vec2_length(Vec2 a) { return sqrt(a.x * a.x + a.y * a.y); }
+
+static inline Vec2 vec2_normalize(Vec2 a) {
+  double len = vec2_length(a);
+  if (len == 0)
+    return (Vec2){0, 0};
+  return (Vec2){a.x / len, a.y / len};
+}
+
+// Rotate around the origin
+static inline Vec2 vec2_rotate(Vec2 p, double angle) {
+  double c = cos(angle), s = sin(angle);
+  return (Vec2){p.x * c - p.y * s, p.x * s + p.y * c};
+}
+
+// --- Bodies and containers ---
+
+typedef struct {
+  double x, y, vx, vy;
+} HcBall;
+
+// Regular polygon rotating about its centre. Vertex i sits at angle
+// angle + 2*pi*i/sides; edge i runs from vertex i to vertex i + 1. The edge
+// arrays are laid out as structure-of-arrays so batched kernels can stream
+// them.
+typedef struct {
+  int sides;
+  Vec2 center;
+  double radius;
+  double omega;       // angular velocity, for the moving-wall response
+  double angle;       // angle of the last hc_shape_update() or hc_shape_turn()
+  double cos_angle, sin_angle;
+  double cos_half, sin_half; // of half the central angle, pi / sides
+  double edge_length;        // same for every edge of a regular polygon
+  double *unit_x, *unit_y; // unrotated unit vertex directions
+  double *vx, *vy;         // vertex i (start of edge i)
+  double *nx, *ny;         // unit normal of edge i, (e.y, -e.x) / |e|
+  double *tx, *ty;         // unit direction of edge i
+} HcShape;
+
+// Returns 0 if the edge arrays cannot be allocated
+int hc_shape_init(HcShape *shape, int sides, Vec2 center, double radius,
+                  double omega);
+void hc_shape_free(HcShape *shape);
+
+// Recompute vertices, normals and tangents for the given rotation angle
+void hc_shape_update(HcShape *shape, double angle);
+
+// Set the rotation angle without touching the edge arrays, which go stale
+// until the next hc_shape_update(). Enough for collisions under
+// HC_LOOKUP_SECTOR: hc_collide() and hc_penetration() then work out the few
+// edges they visit from the angle, so a step costs the same however many
+// sides the shape has.
+void hc_shape_turn(HcShape *shape, double angle);
+
+// --- Model policy ---
+
+// Which balls count as touching edge i
+typedef enum {
+  HC_TEST_CLOSEST,  // distance to the closest point of the segment < radius
+  HC_TEST_LINE,     // signed distance along the edge normal < radius
+  HC_TEST_FOOT,     // as LINE, but only where the foot lies on the segment
+  HC_TEST_LINE_ABS, // |signed distance along the edge normal| < radius
+} HcEdgeTest;
+
+// How a touching ball is moved
+typedef enum {
+  HC_PUSH_OUT,     // out along the contact normal to exactly radius
+  HC_PUSH_TO_LINE, // back along the edge normal onto the edge line
+  HC_PUSH_NONE,
+} HcPush;
+
+// How a touching ball's velocity changes
+typedef enum {
+  // v = -restitution * v_n + tangent_keep * v_t, applied on every contact
+  HC_RESPONSE_SCALE,
+  // Impulse against the moving wall with Coulomb friction (mu), applied
+  // only while the ball approaches the wall
+  HC_RESPONSE_IMPULSE,
+} HcResponse;
+
+// Which edges hc_collide() and hc_penetration() look at
+typedef enum {
+  HC_LOOKUP_ALL, // every edge, in order
+  // Only the edges whose normals lie within the angle the ball could touch
+  // from its polar angle in the rotating frame, in the same order and with
+  // the same results. Each edge is computed from the shape's angle rather
+  // than read from the edge arrays, so the cost per step does not grow with
+  // the number of sides. Narrows the search for HC_TEST_CLOSEST and
+  // HC_TEST_LINE_ABS only; the one-sided tests still visit every edge.
+  HC_LOOKUP_SECTOR,
+} HcLookup;
+
+// How hc_integrate() and hc_step() advance a ball between contacts
+typedef enum {
+  // Semi-implicit Euler: gravity into velocity, then velocity into
+  // position. First order; the position lags the true parabola by
+  // gravity * t * dt / 2.
+  HC_INTEGRATE_EULER,
+  // Velocity Verlet (kick, drift, kick). Exact for constant gravity, like
+  // RK4, at the cost of two velocity updates per step. hc_step() resolves
+  // contacts after the whole step, as for the other integrators.
+  HC_INTEGRATE_VERLET,
+  // Classical fourth-order Runge-Kutta over the whole step
+  HC_INTEGRATE_RK4,
+} HcIntegrator;
+
+typedef struct {
+  double gravity; // acceleration along +y per unit time
+  HcEdgeTest test;
+  HcPush push;
+  HcResponse response;
+  double restitution;
+  double tangent_keep; // HC_RESPONSE_SCALE only
+  double mu;           // HC_RESPONSE_IMPULSE only
+  int first_hit_only;  // stop at the first edge that is touched
+  HcLookup lookup;
+  HcIntegrator integrator;
+  // After hc_step() pushes the ball out of a wall, rescale its speed so the
+  // push does not change its energy: only the response (restitution,
+  // friction) does. Works with any integrator.
+  int keep_energy;
+} HcPolicy;
+
+// "euler", "verlet" or "rk4"; parsing returns 0 for an unknown name
+const char *hc_integrator_name(HcIntegrator integrator);
+int hc_integrator_parse(const char *name, HcIntegrator *integrator);
+
+// --- Kernel ---
+
+// Resolve the ball against a single edge. Returns 1 if the ball bounced; a
+// ball that touches the wall while already leaving it is only pushed out.
+int hc_collide_edge(const HcPolicy *policy, const HcShape *shape, int edge,
+                    HcBall *ball, double radius);
+
+// Resolve the ball against every edge in order (or every edge it can reach,
+// under HC_LOOKUP_SECTOR); returns the bounce count
+int hc_collide(const HcPolicy *policy, const HcShape *shape, HcBall *ball,
+               double radius);
+
+// Deepest overlap of the ball with any edge it touches under the policy's
+// contact test (radius - distance), or 0 if it touches none. The ball is
+// not moved.
+double hc_penetration(const HcPolicy *policy, const HcShape *shape,
+                      const HcBall *ball, double radius);
+
+// Acceleration on a ball in flight. Gravity is the only force, but the
+// higher-order integrators are written against this so they stay correct
+// if it ever depends on the state.
+static inline void hc_acceleration(const HcPolicy *policy, const HcBall *ball,
+                                   double *ax, double *ay) {
+  (void)ball;
+  *ax = 0.0;
+  *ay = policy->gravity;
+}
+
+static inline void hc_kick(const HcPolicy *policy, HcBall *ball, double dt) {
+  double ax, ay;
+  hc_acceleration(policy, ball, &ax, &ay);
+  ball->vx += ax * dt;
+  ball->vy += ay * dt;
+}
+
+static inline void hc_rk4(const HcPolicy *policy, HcBall *ball, double dt) {
+  HcBall k[4]; // derivatives: (dx, dy, dvx, dvy) per stage
+  HcBall stage = *ball;
+  static const double at[4] = {0.0, 0.5, 0.5, 1.0};
+
+  for (int i = 0; i < 4; i++) {
+    if (i > 0) {
+      stage.x = ball->x + k[i - 1].x * at[i] * dt;
+      stage.y = ball->y + k[i - 1].y * at[i] * dt;
+      stage.vx = ball->vx + k[i - 1].vx * at[i] * dt;
+      stage.vy = ball->vy + k[i - 1].vy * at[i] * dt;
+    }
+    k[i].x = stage.vx;
+    k[i].y = stage.vy;
+    hc_acceleration(policy, &stage, &k[i].vx, &k[i].vy);
+  }
+  ball->x += dt / 6 * (k[0].x + 2 * k[1].x + 2 * k[2].x + k[3].x);
+  ball->y += dt / 6 * (k[0].y + 2 * k[1].y + 2 * k[2].y + k[3].y);
+  ball->vx += dt / 6 * (k[0].vx + 2 * k[1].vx + 2 * k[2].vx + k[3].vx);
+  ball->vy += dt / 6 * (k[0].vy + 2 * k[1].vy + 2 * k[2].vy + k[3].vy);
+}
+
+// Advance a ball in free flight by dt with the policy's integrator
+static inline void hc_integrate(const HcPolicy *policy, HcBall *ball,
+                                double dt) {
+  switch (policy->integrator) {
+  case HC_INTEGRATE_EULER:
+    ball->vy += policy->gravity * dt;
+    ball->x += ball->vx * dt;
+    ball->y += ball->vy * dt;
+    break;
+  case HC_INTEGRATE_VERLET:
+    hc_kick(policy, ball, dt / 2);
+    ball->x += ball->vx * dt;
+    ball->y += ball->vy * dt;
+    hc_kick(policy, ball, dt / 2);
+    break;
+  case HC_INTEGRATE_RK4:
+    hc_rk4(policy, ball, dt);
+    break;
+  }
+}
+
+// Rescale the ball's speed for the potential energy it gained or lost when
+// contacts moved it away from height y, if the policy keeps energy
+static inline void hc_project_energy(const HcPolicy *policy, HcBall *ball,
+                                     double y) {
+  if (!policy->keep_energy || ball->y == y)
+    return;
+  double v2 = ball->vx * ball->vx + ball->vy * ball->vy;
+  double target = v2 + 2 * policy->gravity * (ball->y - y);
+  if (v2 > 0) {
+    double s = target > 0 ? sqrt(target / v2) : 0.0;
+    ball->vx *= s;
+    ball->vy *= s;
+  }
+}
+
+// One full step: integrate, then collide; returns the bounce count. Every
+// integrator finishes its step before the contacts are resolved, so the
+// response sees the end-of-step velocity and keep_energy can restore the
+// energy the flight kept.
+static inline int hc_step(const HcPolicy *policy, const HcShape *shape,
+                          HcBall *ball, double radius, double dt) {
+  hc_integrate(policy, ball, dt);
+  double y = ball->y;
+  int contacts = hc_collide(policy, shape, ball, radius);
+  hc_project_energy(policy, ball, y);
+  return contacts;
+}
+
+// Continuous step for a ball inside the polygon. Gravity is applied to the
+// velocity first, as HC_INTEGRATE_EULER does whatever the policy's
+// integrator; the ball then moves in a straight line while the walls rotate
+// at shape->omega, and every time of impact within the step is found and
+// answered with the policy's response, relative to the moving wall. The
+// shape must be at its angle for the END of the step. Anything the sweep
+// cannot settle (for example a ball resting on a wall) is left to a final
+// hc_collide(). Returns the bounce count.
+int hc_sweep(const HcPolicy *policy, const HcShape *shape, HcBall *ball,
+             double radius, double dt);
+
+// --- Event-driven flight ---
+
+// Between contacts the ball flies an exact parabola while the polygon turns
+// at a constant rate, so the next contact can be solved for instead of
+// stepped to.
+
+// Exact free flight for time t under the policy's gravity
+static inline void hc_fly(const HcPolicy *policy, HcBall *ball, double t) {
+  ball->x += ball->vx * t;
+  ball->y += (ball->vy + 0.5 * policy->gravity * t) * t;
+  ball->vy += policy->gravity * t;
+}
+
+// Earliest time within [0, *time] at which a ball inside the polygon, flying
+// freely from now while the polygon turns at shape->omega from
+// shape->angle, touches a wall it is closing in on. Conservative
+// advancement: each step is as long as a bound on the wall gap's curvature
+// allows, so no contact is stepped over, and the steps converge
+// quadratically on a contact. Only the angle is read, so hc_shape_turn() is
+// enough. Returns the edge and sets *time to the contact, or returns -1
+// and leaves *time at a contact-free time to fly to (the given horizon, or
+// short of it after too many iterations). *evals counts gap evaluations.
+int hc_predict_impact(const HcPolicy *policy, const HcShape *shape,
+                      const HcBall *ball, double radius, double *time,
+                      long *evals);
+
+// Answer a ball touching edge at the shape's current angle with the
+// policy's response, relative to the moving wall, without moving it.
+// Returns 1 if it bounced.
+int hc_impact(const HcPolicy *policy, const HcShape *shape, int edge,
+              HcBall *ball, double radius);
+
+// --- Co-rotating frame ---
+
+// A ball can also be integrated in the frame that turns with the shape. The
+// walls then stand still: the shape is built once with omega 0 and never
+// updated, and the frame supplies what the rotation did instead, namely
+// gravity turning the other way plus the centrifugal and Coriolis forces.
+// Those are integrated exactly over each step rather than as forces, so the
+// ball's flight matches hc_integrate() in world space. Stepping needs no
+// trig and no vertex transforms; the rotation is applied only when
+// converting to world space for drawing.
+//
+// Walls at rest in the frame answer the ball's velocity relative to the
+// moving wall, so HC_RESPONSE_SCALE models bounce as they would off a
+// moving wall rather than a static one.
+typedef struct {
+  Vec2 center;
+  double omega;
+  double angle;                // rotation of the frame in world space
+  double dt;                   // step length of hc_frame_step()
+  double gx, gy;               // gravity seen in the frame
+  double turn_cos, turn_sin;   // of omega * dt, the frame's turn per step
+  double cos_angle, sin_angle; // of angle, as of the last hc_frame_sync()
+} HcFrame;
+
+// A frame turning at omega about center, at angle now, stepped by dt
+void hc_frame_init(HcFrame *frame, const HcPolicy *policy, Vec2 center,
+                   double omega, double angle, double dt);
+
+// Refresh the world rotation used by the conversions below; one sin/cos,
+// meant to be called once per drawn frame
+void hc_frame_sync(HcFrame *frame);
+
+// Conversions at the angle of the last hc_frame_sync()
+HcBall hc_frame_from_world(const HcFrame *frame, HcBall world);
+HcBall hc_frame_to_world(const HcFrame *frame, HcBall local);
+
+static inline Vec2 hc_frame_point(const HcFrame *frame, Vec2 local) {
+  double x = local.x - frame->center.x, y = local.y - frame->center.y;
+  return (Vec2){frame->center.x + x * frame->cos_angle - y * frame->sin_angle,
+                frame->center.y + x * frame->sin_angle + y * frame->cos_angle};
+}
+
+// Move a ball one step in the frame at its current angle. Its velocity
+// seen from the fixed world (the frame velocity omega x r added back) takes
+// a semi-implicit Euler step as in hc_integrate(), and the result is turned
+// back by omega * dt into the frame of the end of the step. Taking off
+// omega x r there again is what the centrifugal and Coriolis forces amount
+// to over the step.
+static inline void hc_frame_move(const HcFrame *frame, double *x, double *y,
+                                 double *vx, double *vy) {
+  const double dt = frame->dt, w = frame->omega;
+  const double c = frame->turn_cos, s = frame->turn_sin;
+  double rx = *x - frame->center.x, ry = *y - frame->center.y;
+  double ux = *vx - w * ry + frame->gx * dt;
+  double uy = *vy + w * rx + frame->gy * dt;
+  rx += ux * dt;
+  ry += uy * dt;
+  double qx = rx * c + ry * s, qy = -rx * s + ry * c;
+  *x = frame->center.x + qx;
+  *y = frame->center.y + qy;
+  *vx = ux * c + uy * s + w * qy;
+  *vy = -ux * s + uy * c - w * qx;
+}
+
+// Turn the frame, and the gravity it sees, by omega * dt; call after moving
+// the balls. hc_frame_step() does both itself; batched kernels move every
+// ball with hc_frame_move() and then turn the frame once.
+static inline void hc_frame_turn(HcFrame *frame) {
+  double gx = frame->gx * frame->turn_cos + frame->gy * frame->turn_sin;
+  double gy = -frame->gx * frame->turn_sin + frame->gy * frame->turn_cos;
+  frame->gx = gx;
+  frame->gy = gy;
+  frame->angle += frame->omega * frame->dt;
+}
+
+// Turn the frame by omega * dt and advance a ball given in frame coordinates
+// against the unrotated shape; returns the bounce count
+int hc_frame_step(const HcPolicy *policy, HcFrame *frame, const HcShape *shape,
+                  HcBall *ball, double radius);
+
+#endif
@@ -0,0 +1,227 @@
+#include "hexf32.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HC_F32_X86 1
+#endif
+
+static const char *const isa_names[] = {
+    [HC_ISA_SCALAR] = "scalar",
+    [HC_ISA_SSE2] = "sse2",
+    [HC_ISA_AVX2] = "avx2",
+};
+
+const char *hc_isa_name(HcIsa isa) { return isa_names[isa]; }
+
+int hc_isa_parse(const char *name, HcIsa *isa) {
+  int count = (int)(sizeof(isa_names) / sizeof(*isa_names));
+  for (int i = 0; i < count; i++) {
+    if (strcmp(name, isa_names[i]) == 0) {
+      *isa = (HcIsa)i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int hc_isa_supported(HcIsa isa) {
+  switch (isa) {
+  case HC_ISA_SCALAR:
+    return 1;
+#ifdef HC_F32_X86
+  case HC_ISA_SSE2:
+    return __builtin_cpu_supports("sse2");
+  case HC_ISA_AVX2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return 0;
+  }
+}
+
+HcIsa hc_isa_detect(void) {
+  static int detected = -1;
+  if (detected < 0) {
+    detected = HC_ISA_SCALAR;
+    for (int isa = HC_ISA_AVX2; isa > HC_ISA_SCALAR; isa--) {
+      if (hc_isa_supported((HcIsa)isa)) {
+        detected = isa;
+        break;
+      }
+    }
+  }
+  return (HcIsa)detected;
+}
+
+// Everything a step needs, rounded to float once per call
+typedef struct {
+  int sides;
+  float dt, dv, radius, restitution, keep;
+  float nx[HC_F32_MAX_SIDES], ny[HC_F32_MAX_SIDES];
+  float ox[HC_F32_MAX_SIDES], oy[HC_F32_MAX_SIDES];
+} StepF32;
+
+static void step_scalar(const StepF32 *s, HcBallsF32 *b, size_t from) {
+  for (size_t i = from; i < b->count; i++) {
+    float x = b->x[i], y = b->y[i];
+    float vx = b->vx[i], vy = b->vy[i];
+    vy += s->dv;
+    x += vx * s->dt;
+    y += vy * s->dt;
+
+    for (int k = 0; k < s->sides; k++) {
+      float nx = s->nx[k], ny = s->ny[k];
+      float dist = (x - s->ox[k]) * nx + (y - s->oy[k]) * ny;
+      if (!(dist < s->radius))
+        continue;
+      x += nx * (s->radius - dist);
+      y += ny * (s->radius - dist);
+      float v_dot_n = vx * nx + vy * ny;
+      float vnx = nx * v_dot_n, vny = ny * v_dot_n;
+      vx = vnx * -s->restitution + (vx - vnx) * s->keep;
+      vy = vny * -s->restitution + (vy - vny) * s->keep;
+    }
+
+    b->x[i] = x;
+    b->y[i] = y;
+    b->vx[i] = vx;
+    b->vy[i] = vy;
+  }
+}
+
+#ifdef HC_F32_X86
+// The vector paths apply every edge to every lane and keep the resolved
+// state only in the lanes that hit, as the double SoA kernel in g2.5 does.
+// No FMA, so each lane rounds exactly like step_scalar().
+
+static size_t step_sse2(const StepF32 *s, HcBallsF32 *b) {
+  const __m128 dt = _mm_set1_ps(s->dt), dv = _mm_set1_ps(s->dv);
+  const __m128 radius = _mm_set1_ps(s->radius);
+  const __m128 neg_e = _mm_set1_ps(-s->restitution);
+  const __m128 keep = _mm_set1_ps(s->keep);
+  size_t i = 0;
+  for (; i + 4 <= b->count; i += 4) {
+    __m128 x = _mm_loadu_ps(b->x + i), y = _mm_loadu_ps(b->y + i);
+    __m128 vx = _mm_loadu_ps(b->vx + i), vy = _mm_loadu_ps(b->vy + i);
+    vy = _mm_add_ps(vy, dv);
+    x = _mm_add_ps(x, _mm_mul_ps(vx, dt));
+    y = _mm_add_ps(y, _mm_mul_ps(vy, dt));
+
+    for (int k = 0; k < s->sides; k++) {
+      __m128 nx = _mm_set1_ps(s->nx[k]), ny = _mm_set1_ps(s->ny[k]);
+      __m128 dist = _mm_add_ps(
+          _mm_mul_ps(_mm_sub_ps(x, _mm_set1_ps(s->ox[k])), nx),
+          _mm_mul_ps(_mm_sub_ps(y, _mm_set1_ps(s->oy[k])), ny));
+      __m128 hit = _mm_cmplt_ps(dist, radius);
+      if (!_mm_movemask_ps(hit))
+        continue;
+
+      __m128 depth = _mm_sub_ps(radius, dist);
+      __m128 new_x = _mm_add_ps(x, _mm_mul_ps(nx, depth));
+      __m128 new_y = _mm_add_ps(y, _mm_mul_ps(ny, depth));
+      __m128 v_dot_n = _mm_add_ps(_mm_mul_ps(vx, nx), _mm_mul_ps(vy, ny));
+      __m128 vnx = _mm_mul_ps(nx, v_dot_n), vny = _mm_mul_ps(ny, v_dot_n);
+      __m128 new_vx = _mm_add_ps(_mm_mul_ps(vnx, neg_e),
+                                 _mm_mul_ps(_mm_sub_ps(vx, vnx), keep));
+      __m128 new_vy = _mm_add_ps(_mm_mul_ps(vny, neg_e),
+                                 _mm_mul_ps(_mm_sub_ps(vy, vny), keep));
+
+      // SSE2 has no blend: (new & hit) | (old & ~hit)
+      x = _mm_or_ps(_mm_and_ps(hit, new_x), _mm_andnot_ps(hit, x));
+      y = _mm_or_ps(_mm_and_ps(hit, new_y), _mm_andnot_ps(hit, y));
+      vx = _mm_or_ps(_mm_and_ps(hit, new_vx), _mm_andnot_ps(hit, vx));
+      vy = _mm_or_ps(_mm_and_ps(hit, new_vy), _mm_andnot_ps(hit, vy));
+    }
+
+    _mm_storeu_ps(b->x + i, x);
+    _mm_storeu_ps(b->y + i, y);
+    _mm_storeu_ps(b->vx + i, vx);
+    _mm_storeu_ps(b->vy + i, vy);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t step_avx2(const StepF32 *s,
+                                                        HcBallsF32 *b) {
+  const __m256 dt = _mm256_set1_ps(s->dt), dv = _mm256_set1_ps(s->dv);
+  const __m256 radius = _mm256_set1_ps(s->radius);
+  const __m256 neg_e = _mm256_set1_ps(-s->restitution);
+  const __m256 keep = _mm256_set1_ps(s->keep);
+  size_t i = 0;
+  for (; i + 8 <= b->count; i += 8) {
+    __m256 x = _mm256_loadu_ps(b->x + i), y = _mm256_loadu_ps(b->y + i);
+    __m256 vx = _mm256_loadu_ps(b->vx + i), vy = _mm256_loadu_ps(b->vy + i);
+    vy = _mm256_add_ps(vy, dv);
+    x = _mm256_add_ps(x, _mm256_mul_ps(vx, dt));
+    y = _mm256_add_ps(y, _mm256_mul_ps(vy, dt));
+
+    for (int k = 0; k < s->sides; k++) {
+      __m256 nx = _mm256_set1_ps(s->nx[k]), ny = _mm256_set1_ps(s->ny[k]);
+      __m256 dist = _mm256_add_ps(
+          _mm256_mul_ps(_mm256_sub_ps(x, _mm256_set1_ps(s->ox[k])), nx),
+          _mm256_mul_ps(_mm256_sub_ps(y, _mm256_set1_ps(s->oy[k])), ny));
+      __m256 hit = _mm256_cmp_ps(dist, radius, _CMP_LT_OQ);
+      if (!_mm256_movemask_ps(hit))
+        continue;
+
+      __m256 depth = _mm256_sub_ps(radius, dist);
+      __m256 new_x = _mm256_add_ps(x, _mm256_mul_ps(nx, depth));
+      __m256 new_y = _mm256_add_ps(y, _mm256_mul_ps(ny, depth));
+      __m256 v_dot_n =
+          _mm256_add_ps(_mm256_mul_ps(vx, nx), _mm256_mul_ps(vy, ny));
+      __m256 vnx = _mm256_mul_ps(nx, v_dot_n);
+      __m256 vny = _mm256_mul_ps(ny, v_dot_n);
+      __m256 new_vx = _mm256_add_ps(
+          _mm256_mul_ps(vnx, neg_e),
+          _mm256_mul_ps(_mm256_sub_ps(vx, vnx), keep));
+      __m256 new_vy = _mm256_add_ps(
+          _mm256_mul_ps(vny, neg_e),
+          _mm256_mul_ps(_mm256_sub_ps(vy, vny), keep));
+
+      x = _mm256_blendv_ps(x, new_x, hit);
+      y = _mm256_blendv_ps(y, new_y, hit);
+      vx = _mm256_blendv_ps(vx, new_vx, hit);
+      vy = _mm256_blendv_ps(vy, new_vy, hit);
+    }
+
+    _mm256_storeu_ps(b->x + i, x);
+    _mm256_storeu_ps(b->y + i, y);
+    _mm256_storeu_ps(b->vx + i, vx);
+    _mm256_storeu_ps(b->vy + i, vy);
+  }
+  return i;
+}
+#endif
+
+int hc_step_f32(HcIsa isa, const HcPolicy *policy, const HcShape *shape,
+                HcBallsF32 *balls, double dt) {
+  if (shape->sides > HC_F32_MAX_SIDES || !hc_isa_supported(isa))
+    return 0;
+
+  StepF32 s = {
+      .sides = shape->sides,
+      .dt = (float)dt,
+      .dv = (float)(policy->gravity * dt),
+      .radius = balls->radius,
+      .restitution = (float)policy->restitution,
+      .keep = (float)policy->tangent_keep,
+  };
+  for (int k = 0; k < shape->sides; k++) {
+    s.nx[k] = (float)shape->nx[k];
+    s.ny[k] = (float)shape->ny[k];
+    s.ox[k] = (float)shape->vx[k];
+    s.oy[k] = (float)shape->vy[k];
+  }
+
+  size_t done = 0;
+#ifdef HC_F32_X86
+  if (isa == HC_ISA_AVX2)
+    done = step_avx2(&s, balls);
+  else if (isa == HC_ISA_SSE2)
+    done = step_sse2(&s, balls);
+#endif
+  step_scalar(&s, balls, done);
+  return 1;
+}
@@ -0,0 +1,48 @@
+#ifndef CORE_HEXF32_H
+#define CORE_HEXF32_H
+
+#include <stddef.h>
+
+#include "hexcore.h"
+
+// Single-precision batched kernel for the HC_TEST_LINE / HC_PUSH_OUT /
+// HC_RESPONSE_SCALE policy, stepping many balls in world space with
+// semi-implicit Euler. Each ball takes the same operations in the same order
+// as hc_step() under that policy, in float instead of double, so it tracks
+// the double engines to float rounding. The vector paths step 8 (AVX2) or 4
+// (SSE2) balls at a time against every edge; the remainder of a batch goes
+// through the scalar path.
+
+// Instruction sets the kernel has a path for, in order of preference
+typedef enum {
+  HC_ISA_SCALAR,
+  HC_ISA_SSE2,
+  HC_ISA_AVX2,
+} HcIsa;
+
+#define HC_F32_MAX_SIDES 64
+
+// Many balls of one radius as structure-of-arrays
+typedef struct {
+  float *x, *y;
+  float *vx, *vy;
+  size_t count;
+  float radius;
+} HcBallsF32;
+
+// The best path this CPU supports, asked of CPUID once
+HcIsa hc_isa_detect(void);
+int hc_isa_supported(HcIsa isa);
+
+// "scalar", "sse2" or "avx2"; parsing returns 0 for an unknown name
+const char *hc_isa_name(HcIsa isa);
+int hc_isa_parse(const char *name, HcIsa *isa);
+
+// Advance every ball one step against the shape's current edges. Only the
+// policy's gravity, restitution and tangent_keep are read. Returns 0 without
+// moving anything if the shape has more than HC_F32_MAX_SIDES sides or isa
+// is not supported.
+int hc_step_f32(HcIsa isa, const HcPolicy *policy, const HcShape *shape,
+                HcBallsF32 *balls, double dt);
+
+#endif
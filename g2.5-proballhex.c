@@ -5,8 +5,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <unistd.h> // For usleep
 
+#include "common/damage.h"
+#include "common/eventloop.h"
+#include "common/framebuffer.h"
+#include "common/pacer.h"
+#include "core/hexcore.h"
+#include "core/hexf32.h"
+
 // --- Configuration Constants ---
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
@@ -23,12 +31,15 @@
 #define BALL_RADIUS 20.0f
 #define HEXAGON_ROT_SPEED 0.4f // Radians per second
 
+// Batch mode
+#define HEADLESS_DEFAULT_STEPS 1000
+#define BALL_ARRAY_ALIGN 64 // Cache line, also wide enough for any SIMD width
+#define VALIDATE_TOLERANCE 1e-3 // px and px/s, per step
+
 // --- Data Structures ---
 
 // A simple 2D vector for positions, velocities, etc.
-typedef struct {
-  double x, y;
-} Vec2D;
+typedef Vec2 Vec2D;
 
 // Represents the state of the ball
 typedef struct {
@@ -37,12 +48,28 @@ typedef struct {
   double radius;
 } Ball;
 
+// Many balls stored as structure-of-arrays so the batched kernel can
+// stream each component with unit stride. All balls share one radius.
+typedef struct {
+  double *x, *y;
+  double *vx, *vy;
+  size_t count;
+  double radius;
+  // With use_f32 the balls are stepped here, and x, y, vx and vy are only
+  // refreshed from it for drawing and reporting
+  HcBallsF32 single;
+} BallArray;
+
 // Represents the state of the hexagon
 typedef struct {
   Vec2D center;
   double radius;
   double angle; // Current rotation angle in radians
   double angular_velocity;
+  // Vertices and edge normals at the current angle; with use_frame they
+  // stay at angle 0 and the balls live in the hexagon's rotating frame
+  HcShape shape;
+  HcFrame frame; // used with use_frame
 } Hexagon;
 
 // --- Global Variables ---
@@ -52,20 +79,106 @@ static GC gc;
 static Pixmap buffer; // For double-buffering
 static int screen;
 static Atom wm_delete_window;
+static Framebuffer fb; // Software renderer, used when use_fb is set
+static int use_fb;
+static Damage damage; // Region of the back buffer to redraw
+static int use_frame; // Solve in the hexagon's rotating frame
+static int use_f32;   // Step the ball array in single precision
+static HcIsa f32_isa; // Vector path of the single-precision kernel
+
+// Wall response of this model: every touched edge pushes the ball back to
+// exactly one radius along its normal, then bounces it with friction
+static const HcPolicy physics = {
+  .gravity = GRAVITY,
+  .test = HC_TEST_LINE,
+  .push = HC_PUSH_OUT,
+  .response = HC_RESPONSE_SCALE,
+  .restitution = RESTITUTION,
+  .tangent_keep = 1.0 - FRICTION,
+};
 
 // --- Function Prototypes ---
 void init_x();
 void create_gc();
 void setup_window();
-void run_event_loop();
+void setup_framebuffer();
+void run_event_loop(Ball *ball, Hexagon *hexagon, BallArray *balls);
+void run_headless(Ball *ball, Hexagon *hexagon, BallArray *balls, long steps);
 void cleanup_x();
-void draw_scene(const Ball *ball, const Hexagon *hexagon);
-void update_physics(Ball *ball, Hexagon *hexagon);
+void draw_scene(const Ball *ball, const BallArray *balls,
+                const Hexagon *hexagon);
+void draw_scene_fb(const Ball *ball, const BallArray *balls,
+                   const Hexagon *hexagon);
+int update_physics(Ball *ball, Hexagon *hexagon);
+void update_physics_soa(BallArray *balls, Hexagon *hexagon);
+void update_physics_f32(BallArray *balls, Hexagon *hexagon);
+int validate_f32(BallArray *balls, Hexagon *hexagon, long steps);
+int init_ball_array(BallArray *balls, size_t count, const Hexagon *hexagon);
+void free_ball_array(BallArray *balls);
+static void enter_frame(Ball *ball, BallArray *balls, Hexagon *hexagon);
+static void sync_ball_array(BallArray *balls);
+static Vec2D to_world(const Hexagon *hexagon, Vec2D p);
 
 // --- Main Function ---
-int main() {
-  init_x();
-  setup_window();
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [--balls N [--float] [--isa scalar|sse2|avx2]] [--shm] "
+          "[--rotating-frame] [--headless [--steps N] [--validate]]\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  long num_balls = 0;
+  long steps = HEADLESS_DEFAULT_STEPS;
+  int headless = 0;
+  int validate = 0;
+
+  f32_isa = hc_isa_detect();
+  for (int i = 1; i < argc; ++i) {
+    char *end = NULL;
+    if (strcmp(argv[i], "--headless") == 0) {
+      headless = 1;
+    } else if (strcmp(argv[i], "--shm") == 0) {
+      use_fb = 1;
+    } else if (strcmp(argv[i], "--rotating-frame") == 0) {
+      use_frame = 1;
+    } else if (strcmp(argv[i], "--float") == 0) {
+      use_f32 = 1;
+    } else if (strcmp(argv[i], "--isa") == 0 && i + 1 < argc) {
+      if (!hc_isa_parse(argv[++i], &f32_isa)) {
+        usage(argv[0]);
+        return 1;
+      }
+      use_f32 = 1;
+    } else if (strcmp(argv[i], "--validate") == 0) {
+      validate = 1;
+      use_f32 = 1;
+    } else if (strcmp(argv[i], "--balls") == 0 && i + 1 < argc) {
+      num_balls = strtol(argv[++i], &end, 10);
+    } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+      steps = strtol(argv[++i], &end, 10);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+    if (end && (*end != '\0' || num_balls < 0 || steps < 0)) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (use_f32 && (num_balls == 0 || use_frame)) {
+    fprintf(stderr, "--float needs --balls and works in world space only\n");
+    return 1;
+  }
+  if (validate && !headless) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (use_f32 && !hc_isa_supported(f32_isa)) {
+    fprintf(stderr, "This CPU does not support %s\n", hc_isa_name(f32_isa));
+    return 1;
+  }
 
   // Initialize simulation objects
   Ball ball = {
@@ -80,29 +193,67 @@ int main() {
     .angle = 0.0,
     .angular_velocity = HEXAGON_ROT_SPEED
   };
+  // In the rotating frame the walls stand still
+  if (!hc_shape_init(&hexagon.shape, 6, hexagon.center, hexagon.radius,
+                     use_frame ? 0.0 : hexagon.angular_velocity)) {
+    fprintf(stderr, "Cannot allocate the hexagon\n");
+    return 1;
+  }
 
-  run_event_loop(&ball, &hexagon);
+  BallArray balls = {0};
+  if (num_balls > 0 && !init_ball_array(&balls, num_balls, &hexagon)) {
+    fprintf(stderr, "Cannot allocate %ld balls\n", num_balls);
+    return 1;
+  }
+  if (use_frame)
+    enter_frame(&ball, num_balls > 0 ? &balls : NULL, &hexagon);
+
+  int status = 0;
+  if (validate) {
+    status = !validate_f32(&balls, &hexagon, steps);
+  } else if (headless) {
+    run_headless(&ball, &hexagon, num_balls > 0 ? &balls : NULL, steps);
+  } else {
+    init_x();
+    setup_window();
+    if (use_fb)
+      setup_framebuffer();
+    run_event_loop(&ball, &hexagon, num_balls > 0 ? &balls : NULL);
+    cleanup_x();
+  }
 
-  cleanup_x();
-  return 0;
+  free_ball_array(&balls);
+  hc_shape_free(&hexagon.shape);
+  return status;
 }
 
 // --- X11 and Application Logic ---
 
 /**
  * @brief The main loop: handles events, updates physics, and draws the scene.
+ *
+ * When @p balls is non-NULL the batched structure-of-arrays engine drives the
+ * scene instead of the single @p ball.
  */
-void run_event_loop(Ball *ball, Hexagon *hexagon) {
+void run_event_loop(Ball *ball, Hexagon *hexagon, BallArray *balls) {
   XEvent event;
   int running = 1;
+  Pacer pacer;
+  pacer_init(&pacer, FRAME_RATE);
+  EventLoop loop;
+  evloop_init(&loop, display);
 
   while (running) {
+    // Sleep until X input arrives or the next frame is due
+    int frame = evloop_wait(&loop, &pacer);
+
     // Handle all pending X events
     while (XPending(display)) {
       XNextEvent(display, &event);
       switch (event.type) {
       case Expose:
         // Window needs to be redrawn
+        damage_invalidate(&damage);
         break;
       case KeyPress: {
         KeySym keysym = XLookupKeysym(&event.xkey, 0);
@@ -119,115 +270,550 @@ void run_event_loop(Ball *ball, Hexagon *hexagon) {
         break;
       }
     }
+    if (!running || !frame)
+      continue;
 
     // Update game state
-    update_physics(ball, hexagon);
+    if (balls && use_f32) {
+      update_physics_f32(balls, hexagon);
+      sync_ball_array(balls);
+    } else if (balls) {
+      update_physics_soa(balls, hexagon);
+    } else {
+      update_physics(ball, hexagon);
+    }
 
-    // Draw the new state
-    draw_scene(ball, hexagon);
+    // Draw the new state; the rotating frame is turned to the screen here,
+    // once per frame
+    if (use_frame)
+      hc_frame_sync(&hexagon->frame);
+    if (use_fb)
+      draw_scene_fb(ball, balls, hexagon);
+    else
+      draw_scene(ball, balls, hexagon);
+  }
 
-    // Control frame rate
-    usleep(1000000 / FRAME_RATE);
+  pacer_report(&pacer, stderr);
+  evloop_report(&loop, stderr);
+  evloop_destroy(&loop);
+  if (!use_fb)
+    damage_report(&damage, stderr);
+}
+
+/**
+ * @brief Steps the simulation without a display and reports throughput.
+ */
+void run_headless(Ball *ball, Hexagon *hexagon, BallArray *balls, long steps) {
+  struct timespec start, end;
+  size_t count = balls ? balls->count : 1;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (long i = 0; i < steps; ++i) {
+    if (balls && use_f32)
+      update_physics_f32(balls, hexagon);
+    else if (balls)
+      update_physics_soa(balls, hexagon);
+    else
+      update_physics(ball, hexagon);
   }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (balls && use_f32)
+    sync_ball_array(balls);
+
+  double elapsed =
+      (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+  double ball_steps = (double)count * steps;
+
+  // Mean position doubles as a checksum so the work cannot be elided
+  double mean_x = 0.0, mean_y = 0.0;
+  if (balls) {
+    for (size_t i = 0; i < balls->count; ++i) {
+      mean_x += balls->x[i];
+      mean_y += balls->y[i];
+    }
+    mean_x /= balls->count;
+    mean_y /= balls->count;
+  } else {
+    mean_x = ball->pos.x;
+    mean_y = ball->pos.y;
+  }
+  if (use_frame) {
+    hc_frame_sync(&hexagon->frame);
+    Vec2D mean = to_world(hexagon, (Vec2D){mean_x, mean_y});
+    mean_x = mean.x;
+    mean_y = mean.y;
+  }
+
+  if (balls && use_f32)
+    printf("engine: soa float32, %s\n", hc_isa_name(f32_isa));
+  else
+    printf("engine: %s%s\n", balls ? "soa" : "single",
+           use_frame ? ", rotating frame" : "");
+  printf("balls: %zu\n", count);
+  printf("steps: %ld\n", steps);
+  printf("wall time: %.6f s\n", elapsed);
+  printf("steps/sec: %.1f\n", elapsed > 0 ? steps / elapsed : 0.0);
+  printf("ball-steps/sec: %.0f\n", elapsed > 0 ? ball_steps / elapsed : 0.0);
+  printf("ns/ball-step: %.3f\n",
+         ball_steps > 0 ? elapsed * 1e9 / ball_steps : 0.0);
+  printf("mean position: %.6f %.6f\n", mean_x, mean_y);
 }
 
 /**
- * @brief Updates the position and velocity of objects based on physics.
+ * @brief Advances the hexagon rotation by one step and refreshes its edges.
  */
-void update_physics(Ball *ball, Hexagon *hexagon) {
-  // 1. Update hexagon rotation
+static void rotate_hexagon(Hexagon *hexagon) {
   hexagon->angle += hexagon->angular_velocity * TIME_STEP;
   if (hexagon->angle > 2.0 * M_PI)
     hexagon->angle -= 2.0 * M_PI;
+  hc_shape_update(&hexagon->shape, hexagon->angle);
+}
+
+/**
+ * @brief Moves the scene into the hexagon's rotating frame.
+ *
+ * The frame starts at the hexagon's angle, which is still 0, so positions
+ * are unchanged and only the wall's own motion is taken off the velocities.
+ */
+static void enter_frame(Ball *ball, BallArray *balls, Hexagon *hexagon) {
+  hc_frame_init(&hexagon->frame, &physics, hexagon->center,
+                hexagon->angular_velocity, hexagon->angle, TIME_STEP);
+
+  HcBall b = {ball->pos.x, ball->pos.y, ball->vel.x, ball->vel.y};
+  b = hc_frame_from_world(&hexagon->frame, b);
+  ball->pos = (Vec2D){b.x, b.y};
+  ball->vel = (Vec2D){b.vx, b.vy};
+
+  for (size_t i = 0; balls && i < balls->count; ++i) {
+    b = hc_frame_from_world(&hexagon->frame, (HcBall){balls->x[i], balls->y[i],
+                                                      balls->vx[i],
+                                                      balls->vy[i]});
+    balls->x[i] = b.x;
+    balls->y[i] = b.y;
+    balls->vx[i] = b.vx;
+    balls->vy[i] = b.vy;
+  }
+}
+
+/**
+ * @brief Maps a simulation point to the screen.
+ *
+ * Identity unless the scene lives in the rotating frame, in which case the
+ * rotation of the last hc_frame_sync() is applied.
+ */
+static Vec2D to_world(const Hexagon *hexagon, Vec2D p) {
+  return use_frame ? hc_frame_point(&hexagon->frame, p) : p;
+}
+
+/**
+ * @brief Updates the position and velocity of objects based on physics.
+ *
+ * @return The number of hexagon walls the ball bounced off.
+ */
+int update_physics(Ball *ball, Hexagon *hexagon) {
+  HcBall b = {ball->pos.x, ball->pos.y, ball->vel.x, ball->vel.y};
+  int contacts;
+
+  if (use_frame) {
+    contacts = hc_frame_step(&physics, &hexagon->frame, &hexagon->shape, &b,
+                             ball->radius);
+    hexagon->angle = hexagon->frame.angle;
+  } else {
+    rotate_hexagon(hexagon);
+    contacts = hc_step(&physics, &hexagon->shape, &b, ball->radius, TIME_STEP);
+  }
+  ball->pos = (Vec2D){b.x, b.y};
+  ball->vel = (Vec2D){b.vx, b.vy};
+  return contacts;
+}
 
-  // 2. Apply gravity to the ball
-  ball->vel.y += GRAVITY * TIME_STEP;
+/**
+ * @brief Batched version of update_physics() for a structure-of-arrays.
+ *
+ * The per-ball body is branch-free and the edge loop has a constant trip
+ * count, so the compiler can unroll it and vectorize across balls. A
+ * collision is applied by selecting between the old and the resolved state,
+ * which the vectorizer turns into blends; the arithmetic matches the core's
+ * HC_TEST_LINE / HC_PUSH_OUT / HC_RESPONSE_SCALE path operation for
+ * operation so both engines produce identical trajectories. In the rotating
+ * frame the edges never change and each ball is moved with hc_frame_move(),
+ * as hc_frame_step() does; the mode test is loop-invariant.
+ */
+void update_physics_soa(BallArray *balls, Hexagon *hexagon) {
+  // The balls move in the frame as it was at the start of the step
+  const HcFrame frame = hexagon->frame;
+  if (use_frame) {
+    hc_frame_turn(&hexagon->frame);
+    hexagon->angle = hexagon->frame.angle;
+  } else {
+    rotate_hexagon(hexagon);
+  }
 
-  // 3. Update ball position
-  ball->pos.x += ball->vel.x * TIME_STEP;
-  ball->pos.y += ball->vel.y * TIME_STEP;
+  // Local copies of the edges, so the compiler knows the ball stores below
+  // cannot modify them
+  const HcShape *shape = &hexagon->shape;
+  double nxs[6], nys[6], oxs[6], oys[6];
+  for (int k = 0; k < 6; ++k) {
+    nxs[k] = shape->nx[k];
+    nys[k] = shape->ny[k];
+    oxs[k] = shape->vx[k];
+    oys[k] = shape->vy[k];
+  }
 
-  // 4. Collision detection and response with hexagon walls
-  for (int i = 0; i < 6; ++i) {
-    // Calculate the two vertices of the current edge
-    double angle1 = hexagon->angle + i * (M_PI / 3.0);
-    double angle2 = hexagon->angle + (i + 1) * (M_PI / 3.0);
-
-    Vec2D v1 = {hexagon->center.x + hexagon->radius * cos(angle1),
-                hexagon->center.y + hexagon->radius * sin(angle1)};
-    Vec2D v2 = {hexagon->center.x + hexagon->radius * cos(angle2),
-                hexagon->center.y + hexagon->radius * sin(angle2)};
-
-    // Get the outward-pointing normal of the edge
-    Vec2D edge = {v2.x - v1.x, v2.y - v1.y};
-    Vec2D normal = {edge.y, -edge.x};
-    double len = sqrt(normal.x * normal.x + normal.y * normal.y);
-    normal.x /= len;
-    normal.y /= len;
-
-    // Vector from the first vertex of the edge to the ball's center
-    Vec2D ball_to_v1 = {ball->pos.x - v1.x, ball->pos.y - v1.y};
-
-    // Project this vector onto the normal to get the distance to the line
-    double dist = ball_to_v1.x * normal.x + ball_to_v1.y * normal.y;
-
-    // If the ball is "inside" the wall, a collision has occurred
-    if (dist < ball->radius) {
-      // a. Correct position to prevent sinking into the wall
-      double overlap = ball->radius - dist;
-      ball->pos.x += normal.x * overlap;
-      ball->pos.y += normal.y * overlap;
-
-      // b. Calculate velocity components
-      double v_dot_n = ball->vel.x * normal.x + ball->vel.y * normal.y;
-      Vec2D v_normal = {normal.x * v_dot_n, normal.y * v_dot_n};
-      Vec2D v_tangent = {ball->vel.x - v_normal.x, ball->vel.y - v_normal.y};
-
-      // c. Apply restitution (bouncing) and friction
-      v_normal.x *= -RESTITUTION;
-      v_normal.y *= -RESTITUTION;
-      v_tangent.x *= (1.0 - FRICTION);
-      v_tangent.y *= (1.0 - FRICTION);
-
-      // d. Recombine to get the new velocity
-      ball->vel.x = v_normal.x + v_tangent.x;
-      ball->vel.y = v_normal.y + v_tangent.y;
+  double *restrict px = balls->x;
+  double *restrict py = balls->y;
+  double *restrict pvx = balls->vx;
+  double *restrict pvy = balls->vy;
+  const double radius = balls->radius;
+  const double dt = TIME_STEP;
+  const double dv = physics.gravity * dt;
+  const double restitution = physics.restitution;
+  const double keep = physics.tangent_keep;
+  const size_t n = balls->count;
+  const int in_frame = use_frame;
+
+#pragma omp simd
+  for (size_t i = 0; i < n; ++i) {
+    double x = px[i], y = py[i];
+    double vx = pvx[i], vy = pvy[i];
+    if (in_frame) {
+      hc_frame_move(&frame, &x, &y, &vx, &vy);
+    } else {
+      vy += dv;
+      x += vx * dt;
+      y += vy * dt;
     }
+
+#pragma GCC unroll 6
+    for (int k = 0; k < 6; ++k) {
+      double nx = nxs[k], ny = nys[k];
+      double dist = (x - oxs[k]) * nx + (y - oys[k]) * ny;
+      int hit = dist < radius;
+
+      double new_x = x + nx * (radius - dist);
+      double new_y = y + ny * (radius - dist);
+      double v_dot_n = vx * nx + vy * ny;
+      double vnx = nx * v_dot_n, vny = ny * v_dot_n;
+      double new_vx = vnx * -restitution + (vx - vnx) * keep;
+      double new_vy = vny * -restitution + (vy - vny) * keep;
+
+      x = hit ? new_x : x;
+      y = hit ? new_y : y;
+      vx = hit ? new_vx : vx;
+      vy = hit ? new_vy : vy;
+    }
+
+    px[i] = x;
+    py[i] = y;
+    pvx[i] = vx;
+    pvy[i] = vy;
   }
 }
 
 /**
- * @brief Draws all objects to the screen using a double buffer.
+ * @brief Single-precision version of update_physics_soa().
+ *
+ * The balls in @c balls->single take the same step in float with the
+ * vector path chosen at startup (8 balls at a time with AVX2, 4 with SSE2).
+ * World space only.
  */
-void draw_scene(const Ball *ball, const Hexagon *hexagon) {
-  // 1. Clear the back buffer (draw a black rectangle)
-  XSetForeground(display, gc, BlackPixel(display, screen));
-  XFillRectangle(display, buffer, gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+void update_physics_f32(BallArray *balls, Hexagon *hexagon) {
+  rotate_hexagon(hexagon);
+  hc_step_f32(f32_isa, &physics, &hexagon->shape, &balls->single, TIME_STEP);
+}
 
-  // 2. Draw the hexagon
+/**
+ * @brief Copies the single-precision balls back into the double arrays.
+ */
+static void sync_ball_array(BallArray *balls) {
+  const HcBallsF32 *f = &balls->single;
+  for (size_t i = 0; i < balls->count; ++i) {
+    balls->x[i] = f->x[i];
+    balls->y[i] = f->y[i];
+    balls->vx[i] = f->vx[i];
+    balls->vy[i] = f->vy[i];
+  }
+}
+
+/**
+ * @brief Distance from a contact decision along the reference step.
+ *
+ * Replays one double-precision step of @p b edge by edge and returns how
+ * close any edge came to the dist < radius threshold. Within float rounding
+ * of it the two precisions may legitimately disagree about the bounce.
+ */
+static double contact_margin(const HcShape *shape, HcBall b, double radius) {
+  double margin = INFINITY;
+  hc_integrate(&physics, &b, TIME_STEP);
+  for (int k = 0; k < shape->sides; ++k) {
+    double dist = (b.x - shape->vx[k]) * shape->nx[k] +
+                  (b.y - shape->vy[k]) * shape->ny[k];
+    margin = fmin(margin, fabs(dist - radius));
+    hc_collide_edge(&physics, shape, k, &b, radius);
+  }
+  return margin;
+}
+
+/**
+ * @brief Checks the single-precision kernel against the double one.
+ *
+ * The double engine runs @p steps steps as usual. Before each one the float
+ * balls are set to the rounded double state, and after it both results are
+ * compared ball by ball, so the error measured is one step's worth rather
+ * than the divergence of two chaotic trajectories. A ball-step is within
+ * tolerance if position and velocity agree to VALIDATE_TOLERANCE; one
+ * outside it passes only if the reference came within float rounding of a
+ * contact, where the precisions can take different branches. Prints a
+ * report and returns 0 on any other disagreement.
+ */
+int validate_f32(BallArray *balls, Hexagon *hexagon, long steps) {
+  const float tie = 1e-3f; // px, well above float rounding near the walls
+  HcBallsF32 *f = &balls->single;
+  HcBall *before = malloc(balls->count * sizeof(*before));
+  if (!before) {
+    fprintf(stderr, "Cannot allocate %zu balls\n", balls->count);
+    return 0;
+  }
+
+  double max_pos = 0.0, max_vel = 0.0;
+  long ties = 0, failures = 0;
+  for (long step = 0; step < steps; ++step) {
+    for (size_t i = 0; i < balls->count; ++i) {
+      before[i] = (HcBall){balls->x[i], balls->y[i], balls->vx[i],
+                           balls->vy[i]};
+      f->x[i] = (float)balls->x[i];
+      f->y[i] = (float)balls->y[i];
+      f->vx[i] = (float)balls->vx[i];
+      f->vy[i] = (float)balls->vy[i];
+    }
+    update_physics_soa(balls, hexagon);
+    hc_step_f32(f32_isa, &physics, &hexagon->shape, f, TIME_STEP);
+
+    for (size_t i = 0; i < balls->count; ++i) {
+      double pos = fmax(fabs(f->x[i] - balls->x[i]),
+                        fabs(f->y[i] - balls->y[i]));
+      double vel = fmax(fabs(f->vx[i] - balls->vx[i]),
+                        fabs(f->vy[i] - balls->vy[i]));
+      if (pos <= VALIDATE_TOLERANCE && vel <= VALIDATE_TOLERANCE) {
+        max_pos = fmax(max_pos, pos);
+        max_vel = fmax(max_vel, vel);
+      } else if (contact_margin(&hexagon->shape, before[i], balls->radius) <
+                 tie) {
+        ties++;
+      } else {
+        if (failures++ == 0)
+          fprintf(stderr,
+                  "step %ld ball %zu: float (%g, %g, %g, %g), "
+                  "double (%g, %g, %g, %g)\n",
+                  step, i, f->x[i], f->y[i], f->vx[i], f->vy[i], balls->x[i],
+                  balls->y[i], balls->vx[i], balls->vy[i]);
+      }
+    }
+  }
+  free(before);
+
+  double ball_steps = (double)balls->count * steps;
+  printf("engine: soa float32, %s, against soa double\n",
+         hc_isa_name(f32_isa));
+  printf("ball-steps: %.0f\n", ball_steps);
+  printf("max position error: %.3g px\n", max_pos);
+  printf("max velocity error: %.3g px/s\n", max_vel);
+  printf("contact ties: %ld\n", ties);
+  printf("failures: %ld (tolerance %g)\n", failures, VALIDATE_TOLERANCE);
+  return failures == 0;
+}
+
+/**
+ * @brief Allocates @p count balls scattered inside the hexagon.
+ *
+ * Positions and velocities come from a fixed seed so batch runs are
+ * reproducible. Returns 0 if the arrays cannot be allocated.
+ */
+int init_ball_array(BallArray *balls, size_t count, const Hexagon *hexagon) {
+  size_t bytes = count * sizeof(double);
+  bytes = (bytes + BALL_ARRAY_ALIGN - 1) / BALL_ARRAY_ALIGN * BALL_ARRAY_ALIGN;
+
+  balls->x = aligned_alloc(BALL_ARRAY_ALIGN, bytes);
+  balls->y = aligned_alloc(BALL_ARRAY_ALIGN, bytes);
+  balls->vx = aligned_alloc(BALL_ARRAY_ALIGN, bytes);
+  balls->vy = aligned_alloc(BALL_ARRAY_ALIGN, bytes);
+  balls->count = count;
+  balls->radius = BALL_RADIUS;
+  if (!balls->x || !balls->y || !balls->vx || !balls->vy) {
+    free_ball_array(balls);
+    return 0;
+  }
+
+  HcBallsF32 *f = &balls->single;
+  if (use_f32) {
+    size_t fbytes = count * sizeof(float);
+    fbytes = (fbytes + BALL_ARRAY_ALIGN - 1) / BALL_ARRAY_ALIGN *
+             BALL_ARRAY_ALIGN;
+    f->x = aligned_alloc(BALL_ARRAY_ALIGN, fbytes);
+    f->y = aligned_alloc(BALL_ARRAY_ALIGN, fbytes);
+    f->vx = aligned_alloc(BALL_ARRAY_ALIGN, fbytes);
+    f->vy = aligned_alloc(BALL_ARRAY_ALIGN, fbytes);
+    f->count = count;
+    f->radius = BALL_RADIUS;
+    if (!f->x || !f->y || !f->vx || !f->vy) {
+      free_ball_array(balls);
+      return 0;
+    }
+  }
+
+  // Sample inside the inscribed circle so every ball starts within the walls
+  double max_r = hexagon->radius * cos(M_PI / 6.0) - BALL_RADIUS;
+  srand(1);
+  for (size_t i = 0; i < count; ++i) {
+    double r = max_r * sqrt(rand() / (double)RAND_MAX);
+    double a = 2.0 * M_PI * (rand() / (double)RAND_MAX);
+    balls->x[i] = hexagon->center.x + r * cos(a);
+    balls->y[i] = hexagon->center.y + r * sin(a);
+    balls->vx[i] = 200.0 * (rand() / (double)RAND_MAX) - 100.0;
+    balls->vy[i] = 200.0 * (rand() / (double)RAND_MAX) - 100.0;
+    if (use_f32) {
+      f->x[i] = (float)balls->x[i];
+      f->y[i] = (float)balls->y[i];
+      f->vx[i] = (float)balls->vx[i];
+      f->vy[i] = (float)balls->vy[i];
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Releases the arrays of a BallArray.
+ */
+void free_ball_array(BallArray *balls) {
+  free(balls->x);
+  free(balls->y);
+  free(balls->vx);
+  free(balls->vy);
+  free(balls->single.x);
+  free(balls->single.y);
+  free(balls->single.vx);
+  free(balls->single.vy);
+  *balls = (BallArray){0};
+}
+
+/**
+ * @brief Draws all objects to the screen using a double buffer.
+ *
+ * When @p balls is non-NULL every ball of the array is drawn with a single
+ * XFillArcs request instead of the single @p ball. Only the region damaged
+ * since the last frame (the old and new bounds of the hexagon and balls) is
+ * cleared, redrawn and copied to the window.
+ */
+void draw_scene(const Ball *ball, const BallArray *balls,
+                const Hexagon *hexagon) {
+  // 1. Lay out the hexagon and ball(s), noting the bounds of each
   XPoint points[7];
+  double min_x = WINDOW_WIDTH, min_y = WINDOW_HEIGHT, max_x = 0, max_y = 0;
   for (int i = 0; i < 7; ++i) {
     // The 7th point connects back to the first
     int edge_idx = i % 6;
-    double angle = hexagon->angle + edge_idx * (M_PI / 3.0);
-    points[i].x = (short)(hexagon->center.x + hexagon->radius * cos(angle));
-    points[i].y = (short)(hexagon->center.y + hexagon->radius * sin(angle));
+    Vec2D p = to_world(hexagon, (Vec2D){hexagon->shape.vx[edge_idx],
+                                        hexagon->shape.vy[edge_idx]});
+    points[i].x = (short)p.x;
+    points[i].y = (short)p.y;
+    min_x = fmin(min_x, p.x);
+    min_y = fmin(min_y, p.y);
+    max_x = fmax(max_x, p.x);
+    max_y = fmax(max_y, p.y);
   }
+  damage_add(&damage, min_x, min_y, max_x, max_y);
+
+  static XArc *arcs;
+  static size_t arcs_cap;
+  int n = 0;
+  if (balls) {
+    if (arcs_cap < balls->count) {
+      XArc *grown = realloc(arcs, balls->count * sizeof(*arcs));
+      if (!grown)
+        return;
+      arcs = grown;
+      arcs_cap = balls->count;
+    }
+
+    unsigned short dia = (unsigned short)(balls->radius * 2);
+    for (size_t i = 0; i < balls->count; ++i) {
+      Vec2D p = to_world(hexagon, (Vec2D){balls->x[i], balls->y[i]});
+      double x = p.x - balls->radius;
+      double y = p.y - balls->radius;
+      // Skip balls off the pixmap so the short coordinates cannot overflow
+      if (x < -dia || y < -dia || x > WINDOW_WIDTH || y > WINDOW_HEIGHT)
+        continue;
+      arcs[n++] = (XArc){(short)x, (short)y, dia, dia, 0, 360 * 64};
+      damage_add(&damage, x, y, x + dia, y + dia);
+    }
+  } else {
+    Vec2D p = to_world(hexagon, ball->pos);
+    damage_add(&damage, p.x - ball->radius, p.y - ball->radius,
+               p.x + ball->radius, p.y + ball->radius);
+  }
+
+  // 2. Clip everything below to the damaged region
+  if (!damage_begin(&damage, display, gc))
+    return;
+
+  // 3. Clear the back buffer (draw a black rectangle)
+  XSetForeground(display, gc, BlackPixel(display, screen));
+  XFillRectangle(display, buffer, gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+  // 4. Draw the hexagon
   XSetForeground(display, gc, WhitePixel(display, screen));
   XDrawLines(display, buffer, gc, points, 7, CoordModeOrigin);
 
-  // 3. Draw the ball
+  // 5. Draw the ball(s)
   XSetForeground(display, gc, 0xFF4136); // A nice red color
-  XFillArc(display, buffer, gc, (int)(ball->pos.x - ball->radius),
-           (int)(ball->pos.y - ball->radius), (unsigned int)(ball->radius * 2),
-           (unsigned int)(ball->radius * 2), 0, 360 * 64);
+  if (balls) {
+    XFillArcs(display, buffer, gc, arcs, n);
+  } else {
+    Vec2D p = to_world(hexagon, ball->pos);
+    XFillArc(display, buffer, gc, (int)(p.x - ball->radius),
+             (int)(p.y - ball->radius),
+             (unsigned int)(ball->radius * 2),
+             (unsigned int)(ball->radius * 2), 0, 360 * 64);
+  }
 
-  // 4. Copy the back buffer to the window
+  // 6. Copy the back buffer to the window
   XCopyArea(display, buffer, window, gc, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0,
             0);
+  damage_end(display, gc);
   XFlush(display);
 }
 
+/**
+ * @brief Software-rasterized version of draw_scene().
+ *
+ * The frame is drawn into the client-side framebuffer, which replaces the
+ * back-buffer pixmap, and presented with a single (SHM) put-image request.
+ */
+void draw_scene_fb(const Ball *ball, const BallArray *balls,
+                   const Hexagon *hexagon) {
+  fb_clear(&fb, BlackPixel(display, screen));
+
+  const HcShape *shape = &hexagon->shape;
+  for (int i = 0; i < 6; ++i) {
+    int j = (i + 1) % 6;
+    Vec2D a = to_world(hexagon, (Vec2D){shape->vx[i], shape->vy[i]});
+    Vec2D b = to_world(hexagon, (Vec2D){shape->vx[j], shape->vy[j]});
+    fb_draw_line(&fb, a.x, a.y, b.x, b.y, 2, WhitePixel(display, screen));
+  }
+
+  if (balls) {
+    for (size_t i = 0; i < balls->count; ++i) {
+      Vec2D p = to_world(hexagon, (Vec2D){balls->x[i], balls->y[i]});
+      fb_fill_circle(&fb, p.x, p.y, balls->radius, 0xFF4136);
+    }
+  } else {
+    Vec2D p = to_world(hexagon, ball->pos);
+    fb_fill_circle(&fb, p.x, p.y, ball->radius, 0xFF4136);
+  }
+
+  fb_present(&fb);
+}
+
 // --- X11 Initialization and Cleanup ---
 
 /**
@@ -266,6 +852,19 @@ void setup_window() {
 
   XMapWindow(display, window);
   create_gc();
+  damage_init(&damage, WINDOW_WIDTH, WINDOW_HEIGHT);
+}
+
+/**
+ * @brief Sets up the software framebuffer, falling back to core drawing.
+ */
+void setup_framebuffer() {
+  if (!fb_init(&fb, display, window, gc, WINDOW_WIDTH, WINDOW_HEIGHT)) {
+    fprintf(stderr, "Software renderer unavailable, using core drawing\n");
+    use_fb = 0;
+  } else if (!fb.use_shm) {
+    fprintf(stderr, "MIT-SHM unavailable, presenting with XPutImage\n");
+  }
 }
 
 /**
@@ -282,8 +881,57 @@ void create_gc() {
  * @brief Cleans up X11 resources.
  */
 void cleanup_x() {
+  if (use_fb)
+    fb_destroy(&fb);
   XFreePixmap(display, buffer);
   XFreeGC(display, gc);
   XDestroyWindow(display, window);
   XCloseDisplay(display);
 }
+
+#ifdef BALLHEX_BENCH
+#include "bench/bench.h"
+
+// One ball stepped by the scalar engine
+typedef struct {
+  Ball ball;
+  Hexagon hexagon;
+} BenchState;
+
+static void *bench_init(const BenchScenario *sc) {
+  BenchState *st = malloc(sizeof(*st));
+  if (!st)
+    return NULL;
+  st->hexagon = (Hexagon){
+    .center = {WINDOW_WIDTH / 2.0, WINDOW_HEIGHT / 2.0},
+    .radius = HEXAGON_RADIUS,
+    .angular_velocity = HEXAGON_ROT_SPEED
+  };
+  if (!hc_shape_init(&st->hexagon.shape, 6, st->hexagon.center,
+                     st->hexagon.radius, st->hexagon.angular_velocity)) {
+    free(st);
+    return NULL;
+  }
+  st->ball = (Ball){
+    .pos = {st->hexagon.center.x + sc->x * HEXAGON_RADIUS,
+            st->hexagon.center.y + sc->y * HEXAGON_RADIUS},
+    .vel = {sc->vx * HEXAGON_RADIUS / TIME_STEP,
+            sc->vy * HEXAGON_RADIUS / TIME_STEP},
+    .radius = BALL_RADIUS
+  };
+  return st;
+}
+
+static int bench_step(void *state) {
+  BenchState *st = state;
+  return update_physics(&st->ball, &st->hexagon);
+}
+
+static void bench_fini(void *state) {
+  BenchState *st = state;
+  hc_shape_free(&st->hexagon.shape);
+  free(st);
+}
+
+const BenchModel bench_model = {"g2.5", bench_init, bench_step, bench_fini};
+#endif
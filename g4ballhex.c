@@ -1,91 +1,388 @@
 #include <X11/Xlib.h>
+#include <X11/keysym.h>
+#include <errno.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "common/eventloop.h"
+#include "common/pacer.h"
+#include "common/present.h"
+#include "g4physics.h"
+
 #define WIDTH 800
 #define HEIGHT 600
-#define NUM_SIDES 6
-#define HEX_RADIUS 200.0
-#define BALL_RADIUS 10.0
-#define G 98.0 // pixels per second^2, scaled for visibility
-#define DT 0.01
-#define OMEGA 0.5 // rad/s
-#define RESTITUTION 0.8
-#define MU 0.3
+#define HEADLESS_SECONDS 600.0
+#define BRANCH_COUNT 50     // branches from the window's 'b' key by default
+#define BRANCH_SECONDS 10.0 // simulated seconds each branch runs on
+#define BRANCH_KICK 1.0     // px/s, the velocity change of each branch
 
-typedef struct {
-  double x, y;
-} Point;
+// Advance the scene by one fixed step of DT. Returns the number of walls
+// the ball bounced off.
+static int advance(const HcPolicy *policy, Ball *ball, HcShape *hex,
+                   double *time) {
+  *time += DT;
+  turn_hexagon(policy, hex, OMEGA * *time);
+  return step_ball(policy, ball, hex);
+}
+
+// One step towards time end: DT with fixed stepping, or one adaptive step
+// of whatever length the error control allows when st is non-NULL
+static int advance_step(const HcPolicy *policy, Ball *ball, HcShape *hex,
+                        double *time, AdaptiveStepper *st, double end) {
+  if (!st)
+    return advance(policy, ball, hex, time);
+  double h;
+  int contacts = adaptive_step(st, policy, ball, hex, *time, end - *time, &h);
+  *time += h;
+  return contacts;
+}
+
+static void print_step_rate(FILE *out, const AdaptiveStepper *st,
+                            double seconds) {
+  if (st)
+    fprintf(out,
+            "adaptive steps: %ld (%ld rejected), %.1f per simulated second "
+            "against %.0f fixed\n",
+            st->steps, st->rejected, seconds > 0 ? st->steps / seconds : 0.0,
+            1.0 / DT);
+  else
+    fprintf(out, "fixed steps: %.1f per simulated second\n", 1.0 / DT);
+}
+
+// --- The window's view ---
 
+// The scene as the window shows it, one frame per DT. Fixed stepping moves
+// the ball one DT per frame. Adaptive stepping runs the ball ahead on steps
+// of its own length, which never stop at a frame, and the frame shows it
+// interpolated between the two steps around the frame's time.
 typedef struct {
-  double x, y, vx, vy;
-} Ball;
-
-Point rotate_point(Point p, Point center, double angle) {
-  double s = sin(angle), c = cos(angle);
-  double px = p.x - center.x;
-  double py = p.y - center.y;
-  double nx = px * c - py * s;
-  double ny = px * s + py * c;
-  return (Point){center.x + nx, center.y + ny};
-}
-
-void get_hex_vertices(Point vertices[], Point center, double angle) {
-  for (int i = 0; i < NUM_SIDES; i++) {
-    double theta = 2 * M_PI * i / NUM_SIDES + angle;
-    vertices[i].x = center.x + HEX_RADIUS * cos(theta);
-    vertices[i].y = center.y + HEX_RADIUS * sin(theta);
+  Ball ball, prev; // at time and at prev_time
+  double time, prev_time;
+  double shown; // time of the frame on screen
+} View;
+
+static void view_advance(View *v, const HcPolicy *policy, HcShape *hex,
+                         AdaptiveStepper *st) {
+  v->shown += DT;
+  while (v->time < v->shown) {
+    v->prev = v->ball;
+    v->prev_time = v->time;
+    advance_step(policy, &v->ball, hex, &v->time, st, INFINITY);
   }
 }
 
-Point closest_on_segment(Point pos, Point p1, Point p2) {
-  Point dir = {p2.x - p1.x, p2.y - p1.y};
-  double len2 = dir.x * dir.x + dir.y * dir.y;
-  if (len2 == 0)
-    return p1;
-  double s = ((pos.x - p1.x) * dir.x + (pos.y - p1.y) * dir.y) / len2;
-  s = fmax(0, fmin(1, s));
-  return (Point){p1.x + s * dir.x, p1.y + s * dir.y};
+static Ball view_ball(const View *v) {
+  if (v->time <= v->shown)
+    return v->ball;
+  double f = (v->shown - v->prev_time) / (v->time - v->prev_time);
+  return (Ball){v->prev.x + f * (v->ball.x - v->prev.x),
+                v->prev.y + f * (v->ball.y - v->prev.y),
+                v->prev.vx + f * (v->ball.vx - v->prev.vx),
+                v->prev.vy + f * (v->ball.vy - v->prev.vy)};
 }
 
-Point wall_velocity(Point p, Point center, double omega) {
-  double dx = p.x - center.x;
-  double dy = p.y - center.y;
-  return (Point){-omega * dy, omega * dx};
+// --- What-if branching ---
+
+// Everything the loop advances, enough to carry on exactly from here
+typedef struct {
+  HcPolicy policy;
+  Ball ball;
+  double time;
+  double angle; // of the polygon, OMEGA * time
+  int sides;
+  int adaptive;
+  AdaptiveStepper stepper;
+} Snapshot;
+
+typedef struct {
+  double dvx, dvy; // the perturbation
+  Ball ball;       // state at the end of the branch
+  long contacts;
+  int done; // set last by the worker
+} BranchResult;
+
+static Snapshot take_snapshot(const HcPolicy *policy, const Ball *ball,
+                              const HcShape *hex, double time,
+                              const AdaptiveStepper *st) {
+  return (Snapshot){*policy, *ball, time, OMEGA * time, hex->sides,
+                    st != NULL, st ? *st : (AdaptiveStepper){0}};
 }
 
-void resolve_collision(Ball *ball, Point p1, Point p2, Point center,
-                       double omega) {
-  Point closest = closest_on_segment((Point){ball->x, ball->y}, p1, p2);
-  Point to_ball = {ball->x - closest.x, ball->y - closest.y};
-  double dist = sqrt(to_ball.x * to_ball.x + to_ball.y * to_ball.y);
-  if (dist >= BALL_RADIUS || dist == 0)
-    return;
-  Point normal = {to_ball.x / dist, to_ball.y / dist};
-  double penetration = BALL_RADIUS - dist;
-  ball->x += normal.x * penetration;
-  ball->y += normal.y * penetration;
-  Point v_ball = {ball->vx, ball->vy};
-  Point v_wall = wall_velocity(closest, center, omega);
-  Point v_rel = {v_ball.x - v_wall.x, v_ball.y - v_wall.y};
-  double v_n = v_rel.x * normal.x + v_rel.y * normal.y;
-  if (v_n >= 0)
+// Run one branch on from the snapshot with the ball's velocity kicked by
+// the result's perturbation
+static void run_branch(const Snapshot *snap, double seconds, BranchResult *r) {
+  Point center = {WIDTH / 2.0, HEIGHT / 2.0};
+  HcShape hex;
+  if (!init_polygon(&hex, center, snap->sides))
     return;
-  double j_n = -(1 + RESTITUTION) * v_n;
-  Point tangent = {-normal.y, normal.x};
-  double v_t = v_rel.x * tangent.x + v_rel.y * tangent.y;
-  double j_t = -v_t;
-  double mu_jn = MU * fabs(j_n);
-  if (fabs(j_t) > mu_jn) {
-    j_t = (v_t > 0 ? -mu_jn : mu_jn);
+  turn_hexagon(&snap->policy, &hex, snap->angle);
+  Ball ball = snap->ball;
+  ball.vx += r->dvx;
+  ball.vy += r->dvy;
+  double time = snap->time;
+  AdaptiveStepper stepper = snap->stepper;
+  long frames = (long)(seconds / DT + 0.5);
+  long contacts = 0;
+  if (snap->adaptive)
+    contacts =
+        step_adaptive(&stepper, &snap->policy, &ball, &hex, time, seconds);
+  else
+    for (long i = 0; i < frames; i++)
+      contacts += advance(&snap->policy, &ball, &hex, &time);
+  hc_shape_free(&hex);
+  r->ball = ball;
+  r->contacts = contacts;
+  r->done = 1;
+}
+
+// Runs count branches on from the snapshot and prints one row each. Branch
+// 0 is the unperturbed control; the others kick the ball's velocity by kick
+// in directions spread evenly around the circle. The branches are shared
+// among one forked worker per online CPU, which start from the parent's
+// memory as it is (copy-on-write) and write their rows into a shared table.
+// Where fork() fails the parent runs the worker's share itself.
+static int run_branches(const Snapshot *snap, int count, double seconds,
+                        double kick, FILE *out) {
+  size_t bytes = count * sizeof(BranchResult);
+  BranchResult *table = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (table == MAP_FAILED) {
+    fprintf(stderr, "mmap: %s\n", strerror(errno));
+    return 0;
+  }
+  for (int i = 0; i < count; i++) {
+    double a = i ? 2 * M_PI * (i - 1) / (count - 1) : 0;
+    table[i] = (BranchResult){.dvx = i ? kick * cos(a) : 0,
+                              .dvy = i ? kick * sin(a) : 0};
+  }
+
+  int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  if (workers > count)
+    workers = count;
+  if (workers < 1)
+    workers = 1;
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  fflush(NULL); // nothing buffered gets written twice
+  for (int w = 0; w < workers; w++) {
+    pid_t pid = fork();
+    if (pid > 0)
+      continue;
+    for (int i = w; i < count; i += workers)
+      run_branch(snap, seconds, &table[i]);
+    if (pid == 0)
+      _exit(0);
+  }
+  while (wait(NULL) > 0)
+    ;
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+  const Ball *control = table[0].done ? &table[0].ball : NULL;
+  int failed = 0;
+  fprintf(out, "branch,dvx,dvy,x,y,vx,vy,energy,contacts,divergence\n");
+  for (int i = 0; i < count; i++) {
+    const BranchResult *r = &table[i];
+    if (!r->done) {
+      fprintf(out, "%d,%.6f,%.6f,,,,,,,\n", i, r->dvx, r->dvy);
+      failed++;
+      continue;
+    }
+    double divergence =
+        control ? hypot(r->ball.x - control->x, r->ball.y - control->y) : NAN;
+    fprintf(out, "%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%ld,%.6f\n", i,
+            r->dvx, r->dvy, r->ball.x, r->ball.y, r->ball.vx, r->ball.vy,
+            ball_energy(&r->ball), r->contacts, divergence);
   }
-  ball->vx += j_n * normal.x + j_t * tangent.x;
-  ball->vy += j_n * normal.y + j_t * tangent.y;
+  fprintf(stderr,
+          "%d branches of %.1f s from t = %.3f s in %.3f s on %d workers\n",
+          count, seconds, snap->time, elapsed, workers);
+  if (failed)
+    fprintf(stderr, "%d branches did not finish\n", failed);
+  munmap(table, bytes);
+  return !failed;
 }
 
-int main() {
+static double max_difference(const Ball *a, const Ball *b) {
+  return fmax(fmax(fabs(a->x - b->x), fabs(a->y - b->y)),
+              fmax(fabs(a->vx - b->vx), fabs(a->vy - b->vy)));
+}
+
+// Simulate without a window and print the step statistics. Adaptive steps
+// run over the whole time with their own lengths. With verify, a second
+// copy of the scene is stepped against every edge alongside, and any step
+// where the two disagree is counted.
+static int run_headless(const HcPolicy *policy, AdaptiveStepper *st,
+                        double seconds, int sides, int verify, int branches,
+                        double branch_seconds) {
+  Point center = {WIDTH / 2.0, HEIGHT / 2.0};
+  Ball ball = {center.x, center.y, 0, 0};
+  Ball ref_ball = ball;
+  HcShape hex, ref_hex;
+  AdaptiveStepper ref_stepper = st ? *st : (AdaptiveStepper){0};
+  AdaptiveStepper *ref_st = st ? &ref_stepper : NULL;
+  HcPolicy ref_policy = *policy;
+  double time = 0.0, ref_time = 0.0, max_diff = 0.0;
+  long frames = (long)(seconds / DT + 0.5);
+  long steps, contacts = 0, mismatches = 0;
+  struct timespec t0, t1;
+
+  if (!init_polygon(&hex, center, sides))
+    return 1;
+  if (verify && !init_polygon(&ref_hex, center, sides)) {
+    hc_shape_free(&hex);
+    return 1;
+  }
+  ref_policy.lookup = HC_LOOKUP_ALL;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  for (steps = 0; st ? seconds - time > 1e-12 : steps < frames; steps++) {
+    contacts += advance_step(policy, &ball, &hex, &time, st, seconds);
+    if (!verify)
+      continue;
+    advance_step(&ref_policy, &ref_ball, &ref_hex, &ref_time, ref_st,
+                 seconds);
+    double diff = max_difference(&ball, &ref_ball);
+    if (diff > 0)
+      mismatches++;
+    max_diff = fmax(max_diff, diff);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+
+  printf("sides: %d (%s edge lookup)\n", sides,
+         policy->lookup == HC_LOOKUP_SECTOR ? "sector" : "every");
+  printf("integrator: %s%s\n", hc_integrator_name(policy->integrator),
+         policy->keep_energy ? " (energy kept through push-outs)" : "");
+  printf("simulated time: %.3f s\n", time);
+  printf("wall time: %.6f s\n", elapsed);
+  print_step_rate(stdout, st, time);
+  printf("contacts: %ld\n", contacts);
+  printf("ball pos: %.6f %.6f\n", ball.x, ball.y);
+  printf("ball vel: %.6f %.6f\n", ball.vx, ball.vy);
+  printf("energy: %.6f\n", ball_energy(&ball));
+  if (verify) {
+    printf("verify: %ld of %ld steps differ from every-edge stepping, "
+           "max difference %g\n",
+           mismatches, steps, max_diff);
+    hc_shape_free(&ref_hex);
+  }
+  int status = mismatches ? 1 : 0;
+  if (branches > 0) {
+    Snapshot snap = take_snapshot(policy, &ball, &hex, time, st);
+    if (!run_branches(&snap, branches, branch_seconds, BRANCH_KICK, stdout))
+      status = 1;
+  }
+  hc_shape_free(&hex);
+  return status;
+}
+
+// Fly the scene from rest to seconds between contacts and compare the work
+// done with the steps fixed DT stepping would take
+static int run_events(const HcPolicy *policy, double seconds, int sides) {
+  Point center = {WIDTH / 2.0, HEIGHT / 2.0};
+  Ball ball = {center.x, center.y, 0, 0};
+  HcShape hex;
+  EventStepper ev;
+  struct timespec t0, t1;
+
+  if (!init_polygon(&hex, center, sides))
+    return 1;
+  events_init(&ev, 0.0);
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  long contacts = step_events(&ev, policy, &ball, &hex, seconds);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+  long fixed = (long)(seconds / DT + 0.5);
+
+  printf("sides: %d (%s edge lookup)\n", sides,
+         policy->lookup == HC_LOOKUP_SECTOR ? "sector" : "every");
+  printf("simulated time: %.3f s\n", ev.time);
+  printf("wall time: %.6f s\n", elapsed);
+  printf("impacts solved: %ld, gap evaluations: %ld, DT steps: "
+         "%ld\n",
+         ev.impacts, ev.evals, ev.steps);
+  printf("fixed steps for the same time: %ld (%.1fx the evaluations and "
+         "steps)\n",
+         fixed, (double)fixed / fmax(ev.evals + ev.steps, 1));
+  printf("contacts: %ld\n", contacts);
+  printf("ball pos: %.6f %.6f\n", ball.x, ball.y);
+  printf("ball vel: %.6f %.6f\n", ball.vx, ball.vy);
+  printf("energy: %.6f\n", ball_energy(&ball));
+  hc_shape_free(&hex);
+  return 0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [--adaptive] [--sides N] [--all-edges] "
+          "[--integrator euler|verlet|rk4] [--keep-energy]\n"
+          "       [--branches N [--branch-seconds S]] "
+          "[--headless [--seconds S] [--verify]]\n"
+          "       [--sides N] [--all-edges] --headless --events "
+          "[--seconds S]\n",
+          prog);
+}
+
+int main(int argc, char **argv) {
+  int adaptive = 0, headless = 0, verify = 0, events = 0;
+  int sides = NUM_SIDES;
+  double seconds = HEADLESS_SECONDS;
+  int branches = 0;
+  double branch_seconds = BRANCH_SECONDS;
+  AdaptiveStepper stepper;
+  G4Config config = g4_defaults;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--adaptive") == 0) {
+      adaptive = 1;
+    } else if (strcmp(argv[i], "--headless") == 0) {
+      headless = 1;
+    } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--sides") == 0 && i + 1 < argc) {
+      sides = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--all-edges") == 0) {
+      config.lookup = HC_LOOKUP_ALL;
+    } else if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc) {
+      if (!hc_integrator_parse(argv[++i], &config.integrator)) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--keep-energy") == 0) {
+      config.keep_energy = 1;
+    } else if (strcmp(argv[i], "--verify") == 0) {
+      verify = 1;
+    } else if (strcmp(argv[i], "--events") == 0) {
+      events = 1;
+    } else if (strcmp(argv[i], "--branches") == 0 && i + 1 < argc) {
+      branches = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--branch-seconds") == 0 && i + 1 < argc) {
+      branch_seconds = atof(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (sides < 3 || branches < 0 || !(branch_seconds > 0) ||
+      (events && (!headless || adaptive || verify || branches))) {
+    usage(argv[0]);
+    return 1;
+  }
+  adaptive_init(&stepper);
+  AdaptiveStepper *st = adaptive ? &stepper : NULL;
+  HcPolicy policy = g4_policy(&config, RESTITUTION, MU);
+  if (events)
+    return run_events(&policy, seconds, sides);
+  if (headless)
+    return run_headless(&policy, st, seconds, sides, verify, branches,
+                        branch_seconds);
+
   Display *display = XOpenDisplay(NULL);
   if (!display)
     exit(1);
@@ -98,45 +395,112 @@ int main() {
   XMapWindow(display, window);
   GC gc = XCreateGC(display, window, 0, NULL);
   XSetForeground(display, gc, BlackPixel(display, screen));
-  Ball ball = {WIDTH / 2.0, HEIGHT / 2.0, 0, 0};
+  View view = {.ball = {WIDTH / 2.0, HEIGHT / 2.0, 0, 0}};
   Point center = {WIDTH / 2.0, HEIGHT / 2.0};
-  double time = 0.0;
-  Point vertices[NUM_SIDES];
+  HcShape hex;
+  if (!init_polygon(&hex, center, sides))
+    exit(1);
+  XPoint *points = malloc((sides + 1) * sizeof(*points));
+  if (!points)
+    exit(1);
   Atom wm_delete = XInternAtom(display, "WM_DELETE_WINDOW", True);
   XSetWMProtocols(display, window, &wm_delete, 1);
-  while (1) {
+  Presenter present;
+  present_init(&present, display, window);
+  Pacer pacer;
+  pacer_init(&pacer, 1.0 / DT);
+  EventLoop loop;
+  evloop_init(&loop, display);
+  int running = 1;
+  while (running) {
+    int frame = evloop_wait(&loop, &pacer);
     while (XPending(display)) {
       XEvent event;
       XNextEvent(display, &event);
       if (event.type == ClientMessage)
-        exit(0);
-      if (event.type == KeyPress)
-        exit(0);
-    }
-    time += DT;
-    double angle = OMEGA * time;
-    get_hex_vertices(vertices, center, angle);
-    ball.vy += G * DT;
-    ball.x += ball.vx * DT;
-    ball.y += ball.vy * DT;
-    for (int i = 0; i < NUM_SIDES; i++) {
-      Point p1 = vertices[i];
-      Point p2 = vertices[(i + 1) % NUM_SIDES];
-      resolve_collision(&ball, p1, p2, center, OMEGA);
+        running = 0;
+      if (event.type != KeyPress)
+        continue;
+      // b branches from the state on screen; any other key quits
+      if (XLookupKeysym(&event.xkey, 0) == XK_b) {
+        Snapshot snap =
+            take_snapshot(&policy, &view.ball, &hex, view.time, st);
+        run_branches(&snap, branches ? branches : BRANCH_COUNT,
+                     branch_seconds, BRANCH_KICK, stdout);
+        fflush(stdout);
+      } else {
+        running = 0;
+      }
     }
-    XClearWindow(display, window);
-    XPoint points[NUM_SIDES + 1];
-    for (int i = 0; i < NUM_SIDES; i++) {
-      points[i].x = (short)vertices[i].x;
-      points[i].y = (short)vertices[i].y;
+    if (!running)
+      break;
+    if (!frame)
+      continue;
+    view_advance(&view, &policy, &hex, st);
+    Ball ball = view_ball(&view);
+    present_begin(&present);
+    hc_shape_update(&hex, OMEGA * view.shown);
+    for (int i = 0; i < sides; i++) {
+      points[i].x = (short)hex.vx[i];
+      points[i].y = (short)hex.vy[i];
     }
-    points[NUM_SIDES] = points[0];
-    XDrawLines(display, window, gc, points, NUM_SIDES + 1, CoordModeOrigin);
-    XFillArc(display, window, gc, (int)(ball.x - BALL_RADIUS),
+    points[sides] = points[0];
+    XDrawLines(display, present.target, gc, points, sides + 1,
+               CoordModeOrigin);
+    XFillArc(display, present.target, gc, (int)(ball.x - BALL_RADIUS),
              (int)(ball.y - BALL_RADIUS), (int)(2 * BALL_RADIUS),
              (int)(2 * BALL_RADIUS), 0, 360 * 64);
-    XFlush(display);
-    usleep((int)(DT * 1000000));
+    present_swap(&present);
   }
+  pacer_report(&pacer, stderr);
+  evloop_report(&loop, stderr);
+  evloop_destroy(&loop);
+  present_report(&present, stderr);
+  print_step_rate(stderr, st, view.time);
+  present_destroy(&present);
+  free(points);
+  hc_shape_free(&hex);
   XCloseDisplay(display);
-}
\ No newline at end of file
+  return 0;
+}
+
+#ifdef BALLHEX_BENCH
+#include "bench/bench.h"
+
+typedef struct {
+  HcPolicy policy;
+  Ball ball;
+  HcShape hex;
+  double time;
+} BenchState;
+
+static void *bench_init(const BenchScenario *sc) {
+  BenchState *st = malloc(sizeof(*st));
+  Point center = {WIDTH / 2.0, HEIGHT / 2.0};
+  if (!st || !init_hexagon(&st->hex, center)) {
+    free(st);
+    return NULL;
+  }
+  st->ball = (Ball){center.x + sc->x * HEX_RADIUS,
+                    center.y + sc->y * HEX_RADIUS, sc->vx * HEX_RADIUS / DT,
+                    sc->vy * HEX_RADIUS / DT};
+  st->policy = g4_policy(&g4_defaults, RESTITUTION, MU);
+  st->time = 0.0;
+  return st;
+}
+
+static int bench_step(void *state) {
+  BenchState *st = state;
+  st->time += DT;
+  turn_hexagon(&st->policy, &st->hex, OMEGA * st->time);
+  return step_ball(&st->policy, &st->ball, &st->hex);
+}
+
+static void bench_fini(void *state) {
+  BenchState *st = state;
+  hc_shape_free(&st->hex);
+  free(st);
+}
+
+const BenchModel bench_model = {"g4", bench_init, bench_step, bench_fini};
+#endif
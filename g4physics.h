@@ -0,0 +1,309 @@
+#ifndef G4PHYSICS_H
+#define G4PHYSICS_H
+
+#include <stdint.h>
+
+#include "core/hexcore.h"
+
+#ifndef NUM_SIDES
+#define NUM_SIDES 6
+#endif
+#define HEX_RADIUS 200.0
+#define BALL_RADIUS 10.0
+#define G 98.0 // pixels per second^2, scaled for visibility
+#define DT 0.01
+#define OMEGA 0.5 // rad/s
+#define RESTITUTION 0.8
+#define MU 0.3
+
+typedef Vec2 Point;
+typedef HcBall Ball;
+
+// How g4 steps. The sector lookup keeps the cost of an edge search flat for
+// containers with many sides; HC_LOOKUP_ALL tests every edge and serves as
+// its reference. Flight between contacts is semi-implicit Euler unless
+// chosen otherwise, and being pushed out of a wall may change the ball's
+// energy unless keep_energy is set.
+typedef struct {
+  HcLookup lookup;
+  HcIntegrator integrator;
+  int keep_energy;
+} G4Config;
+
+static const G4Config g4_defaults = {HC_LOOKUP_SECTOR, HC_INTEGRATE_EULER, 0};
+
+// g4 bounces the ball off the closest point of each wall with an impulse
+// against the moving wall, limited by Coulomb friction
+static inline HcPolicy g4_policy(const G4Config *config, double restitution,
+                                 double mu) {
+  return (HcPolicy){
+      .gravity = G,
+      .test = HC_TEST_CLOSEST,
+      .push = HC_PUSH_OUT,
+      .response = HC_RESPONSE_IMPULSE,
+      .restitution = restitution,
+      .mu = mu,
+      .lookup = config->lookup,
+      .integrator = config->integrator,
+      .keep_energy = config->keep_energy,
+  };
+}
+
+// A regular polygon the size of the hexagon, rotating at OMEGA about center;
+// free with hc_shape_free()
+static inline int init_polygon(HcShape *hex, Point center, int sides) {
+  return hc_shape_init(hex, sides, center, HEX_RADIUS, OMEGA);
+}
+
+static inline int init_hexagon(HcShape *hex, Point center) {
+  return init_polygon(hex, center, NUM_SIDES);
+}
+
+// Balls spread over the inside of the hexagon with speeds up to 2 radii per
+// second, from a fixed seed so every run starts from the same states
+static inline void init_balls(Ball *balls, int count, Point center) {
+  double reach = HEX_RADIUS * cos(M_PI / NUM_SIDES) - BALL_RADIUS;
+  uint64_t seed = 1;
+  for (int i = 0; i < count; i++) {
+    double u[4];
+    for (int k = 0; k < 4; k++) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      u[k] = (seed >> 11) * (1.0 / 9007199254740992.0);
+    }
+    double r = reach * sqrt(u[0]), a = 2 * M_PI * u[1];
+    double speed = 2 * HEX_RADIUS * u[2], heading = 2 * M_PI * u[3];
+    balls[i] = (Ball){center.x + r * cos(a), center.y + r * sin(a),
+                      speed * cos(heading), speed * sin(heading)};
+  }
+}
+
+// Turn the hexagon to angle for the next step under policy. The sector
+// lookup reads nothing but the angle, so the edge arrays are only refreshed
+// for HC_LOOKUP_ALL; call hc_shape_update() before drawing them.
+static inline void turn_hexagon(const HcPolicy *policy, HcShape *hex,
+                                double angle) {
+  if (policy->lookup == HC_LOOKUP_SECTOR)
+    hc_shape_turn(hex, angle);
+  else
+    hc_shape_update(hex, angle);
+}
+
+// Advance the ball by one DT against the hexagon at its current angle.
+// Returns the number of walls it bounced off.
+static inline int step_ball(const HcPolicy *policy, Ball *ball,
+                            const HcShape *hex) {
+  return hc_step(policy, hex, ball, BALL_RADIUS, DT);
+}
+
+// --- Adaptive stepping ---
+
+// Error control for adaptive_step(). Between contacts gravity is the only
+// force, so the exact parabola (hc_fly()) serves as the reference for each
+// trial step of length h: the step is rejected and halved when the policy's
+// integrator ends it with an energy more than tol_energy (relative to
+// G * HEX_RADIUS) away from the parabola's, or lets the ball sink further
+// than tol_penetration into a wall. That costs one integration per trial
+// rather than three for a step and two half steps. In free flight h grows
+// to h_max; around impacts it shrinks towards h_min. A ball resting on a
+// wall touches it whatever the step, so while it keeps touching, steps no
+// longer than DT are taken as they are, as step_ball() would.
+typedef struct {
+  double tol_penetration; // pixels
+  double tol_energy;
+  double h_min, h_max;
+  double h;      // next step length to try
+  int touching;  // the last accepted step ended against a wall
+  long steps;    // accepted steps
+  long rejected; // trial steps thrown away
+} AdaptiveStepper;
+
+#define ADAPTIVE_TOL_PENETRATION 0.1
+#define ADAPTIVE_TOL_ENERGY 1e-4
+#define ADAPTIVE_H_MIN (DT / 64)
+#define ADAPTIVE_H_MAX (DT * 8)
+
+static inline void adaptive_init(AdaptiveStepper *st) {
+  *st = (AdaptiveStepper){
+      .tol_penetration = ADAPTIVE_TOL_PENETRATION,
+      .tol_energy = ADAPTIVE_TOL_ENERGY,
+      .h_min = ADAPTIVE_H_MIN,
+      .h_max = ADAPTIVE_H_MAX,
+      .h = DT,
+  };
+}
+
+// Kinetic plus potential energy per unit mass; gravity points along +y
+static inline double ball_energy(const Ball *ball) {
+  return 0.5 * (ball->vx * ball->vx + ball->vy * ball->vy) - G * ball->y;
+}
+
+// Take one accepted step from time t, no longer than max: st->h is tried
+// first and halved for as long as the error control rejects it. Sets *taken
+// to the step's length and leaves the hexagon turned to the end of it.
+// Returns the number of walls the ball bounced off.
+static inline int adaptive_step(AdaptiveStepper *st, const HcPolicy *policy,
+                                Ball *ball, HcShape *hex, double t,
+                                double max, double *taken) {
+  double energy_scale = G * HEX_RADIUS;
+  for (;;) {
+    double h = fmin(st->h, max);
+    Ball trial = *ball, exact = *ball;
+    turn_hexagon(policy, hex, OMEGA * (t + h));
+    hc_integrate(policy, &trial, h);
+    hc_fly(policy, &exact, h);
+    double energy_error =
+        fabs(ball_energy(&trial) - ball_energy(&exact)) / energy_scale;
+    // The push out of the walls is as long as the ball sank into them
+    double x = trial.x, y = trial.y;
+    int hits = hc_collide(policy, hex, &trial, BALL_RADIUS);
+    double depth = hypot(trial.x - x, trial.y - y);
+    int within = depth <= st->tol_penetration && energy_error <= st->tol_energy;
+    if (!within && h > st->h_min && !(st->touching && depth > 0 && h <= DT)) {
+      st->h = fmax(h / 2, st->h_min);
+      st->rejected++;
+      continue;
+    }
+
+    hc_project_energy(policy, &trial, y);
+    *ball = trial;
+    st->touching = depth > 0;
+    st->steps++;
+    if (depth < st->tol_penetration / 4 && energy_error < st->tol_energy / 4)
+      st->h = fmin(2 * st->h, st->h_max);
+    *taken = h;
+    return hits;
+  }
+}
+
+// Advance the ball from time t by duration, in as many steps as the error
+// control needs. Steps keep their own length and only the last one is cut
+// short to land on t + duration, so call this over a whole run or sample
+// interval rather than per frame. Leaves the hexagon turned to
+// OMEGA * (t + duration). Returns the number of walls the ball bounced off.
+static inline int step_adaptive(AdaptiveStepper *st, const HcPolicy *policy,
+                                Ball *ball, HcShape *hex, double t,
+                                double duration) {
+  double end = t + duration;
+  int contacts = 0;
+  while (end - t > 1e-12) {
+    double h;
+    contacts += adaptive_step(st, policy, ball, hex, t, end - t, &h);
+    t += h;
+  }
+  turn_hexagon(policy, hex, OMEGA * end);
+  return contacts;
+}
+
+// --- Event-driven flight ---
+
+// Between contacts the ball is flown straight to the next one on its exact
+// parabola, so a long quiet flight costs a handful of gap evaluations rather
+// than a step per DT. Near the walls prediction sees only a short way ahead
+// and stepping is cheaper, so the ball falls back to DT steps like
+// step_ball() in two cases:
+//   - it bounces again within DT of its last contact, so it is rolling or
+//     chattering towards rest, where contacts pile up without end;
+//   - a prediction saved fewer DT steps than its gap evaluations cost. The
+//     ball then steps for a while before predicting again, twice as long
+//     each time this happens in a row.
+// Flight is exact whatever the policy's integrator says.
+//
+// events_plan() looks ahead to the ball's next event and events_take()
+// carries it out, so a scheduler can order the events of many balls by
+// their next times.
+typedef struct {
+  double time;           // the ball is here
+  double last_contact;   // time of the latest bounce
+  double next;           // time of the planned event
+  double stepping_until; // DT steps rather than predictions up to here
+  double backoff;        // length of the next such run of DT steps
+  int edge;              // wall hit at next, or -1 for flight alone
+  int crowded;           // the planned event is a run of DT steps
+  long evals;            // wall gap evaluations spent predicting
+  long impacts;          // contacts solved for exactly
+  long steps;            // DT steps taken
+} EventStepper;
+
+// What one gap evaluation costs, in DT steps
+#define EVENTS_EVAL_COST 4
+// Longest run of DT steps before predicting again, in simulated seconds
+#define EVENTS_MAX_BACKOFF 4.0
+
+static inline void events_init(EventStepper *ev, double time) {
+  *ev = (EventStepper){.time = time,
+                       .last_contact = -INFINITY,
+                       .stepping_until = time,
+                       .backoff = DT,
+                       .edge = -1};
+}
+
+// Plan the ball's next event, at the latest at time end
+static inline void events_plan(EventStepper *ev, const HcPolicy *policy,
+                               const Ball *ball, HcShape *hex, double end) {
+  double h = end - ev->time;
+  ev->edge = -1;
+  ev->crowded = ev->time < ev->stepping_until;
+  if (ev->crowded) {
+    h = fmin(ev->stepping_until - ev->time, h);
+  } else {
+    long evals = ev->evals;
+    turn_hexagon(policy, hex, OMEGA * ev->time);
+    ev->edge =
+        hc_predict_impact(policy, hex, ball, BALL_RADIUS, &h, &ev->evals);
+    // The flight is flown either way; the cost only decides what follows
+    if (h < (ev->evals - evals) * EVENTS_EVAL_COST * DT) {
+      ev->stepping_until = ev->time + h + ev->backoff;
+      ev->backoff = fmin(2 * ev->backoff, EVENTS_MAX_BACKOFF);
+    } else {
+      ev->backoff = DT;
+    }
+    ev->crowded = ev->edge >= 0 && ev->time + h - ev->last_contact < DT;
+    if (ev->crowded)
+      h = fmin(DT, end - ev->time);
+  }
+  ev->next = h < end - ev->time ? ev->time + h : end;
+}
+
+// Carry out the planned event, leaving the hexagon turned to its time.
+// Returns the number of walls the ball bounced off.
+static inline int events_take(EventStepper *ev, const HcPolicy *policy,
+                              Ball *ball, HcShape *hex) {
+  if (ev->crowded) {
+    int contacts = 0;
+    while (ev->time < ev->next) {
+      double h = fmin(DT, ev->next - ev->time);
+      ev->time = h < ev->next - ev->time ? ev->time + h : ev->next;
+      turn_hexagon(policy, hex, OMEGA * ev->time);
+      int hits = hc_step(policy, hex, ball, BALL_RADIUS, h);
+      if (hits)
+        ev->last_contact = ev->time;
+      contacts += hits;
+      ev->steps++;
+    }
+    return contacts;
+  }
+
+  double h = ev->next - ev->time;
+  ev->time = ev->next;
+  turn_hexagon(policy, hex, OMEGA * ev->time);
+  hc_fly(policy, ball, h);
+  if (ev->edge < 0 || !hc_impact(policy, hex, ev->edge, ball, BALL_RADIUS))
+    return 0;
+  ev->last_contact = ev->time;
+  ev->impacts++;
+  return 1;
+}
+
+// Advance the ball to time end. Leaves the hexagon turned to OMEGA * end.
+// Returns the number of walls the ball bounced off.
+static inline int step_events(EventStepper *ev, const HcPolicy *policy,
+                              Ball *ball, HcShape *hex, double end) {
+  int contacts = 0;
+  while (ev->time < end) {
+    events_plan(ev, policy, ball, hex, end);
+    contacts += events_take(ev, policy, ball, hex);
+  }
+  return contacts;
+}
+
+#endif
@@ -3,20 +3,27 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "common/eventloop.h"
+#include "common/pacer.h"
+#include "common/present.h"
+#include "core/hexcore.h"
+
 // Constants
 #define WIDTH 800
 #define HEIGHT 600
-#define GRAVITY 0.1
+#define FRAME_RATE 60
+#define DT (1.0 / FRAME_RATE) // simulated seconds per physics step
+#define GRAVITY 360.0         // pixels per second squared
+#define ROTATION_SPEED 0.6    // radians per second
 #define FRICTION 0.9
 #define HEXAGON_SIZE 200
 #define BALL_SIZE 20
 
 // Structure to represent a point
-typedef struct {
-    double x, y;
-} Point;
+typedef Vec2 Point;
 
 // Structure to represent the ball
 typedef struct {
@@ -25,7 +32,7 @@ typedef struct {
 } Ball;
 
 // Function to create a new X11 window
-Display* create_window() {
+Display* create_window(Window* out) {
     Display* display = XOpenDisplay(NULL);
     if (!display) {
         fprintf(stderr, "Failed to open display\n");
@@ -38,6 +45,7 @@ Display* create_window() {
     XSelectInput(display, window, ExposureMask | KeyPressMask);
     XMapWindow(display, window);
 
+    *out = window;
     return display;
 }
 
@@ -59,94 +67,166 @@ void draw_hexagon(Display* display, Window window, GC gc, Point center, double s
     XDrawLines(display, window, gc, x_vertices, 6, CoordModeOrigin);
 }
 
-// Function to update the ball's position and velocity
-void update_ball(Ball* ball) {
-    ball->velocity.y += GRAVITY;
-    ball->position.x += ball->velocity.x;
-    ball->position.y += ball->velocity.y;
+// Wall response: reflect the normal velocity scaled by FRICTION and move
+// the ball's centre back onto the wall line. The integrator can be changed
+// with --integrator, and --keep-energy stops the push onto the line from
+// changing the ball's energy.
+static HcPolicy physics = {
+    .gravity = GRAVITY,
+    .test = HC_TEST_LINE,
+    .push = HC_PUSH_TO_LINE,
+    .response = HC_RESPONSE_SCALE,
+    .restitution = 2 * FRICTION - 1,
+    .tangent_keep = 1,
+};
+
+// Function to update the ball's position and velocity by dt seconds and
+// bounce it off the hexagon walls.
+// Returns the number of walls the ball bounced off.
+int update_ball(Ball* ball, const HcShape* hexagon, double dt) {
+    HcBall b = {ball->position.x, ball->position.y, ball->velocity.x, ball->velocity.y};
+    int contacts = hc_step(&physics, hexagon, &b, BALL_SIZE / 2, dt);
+    ball->position = (Point){b.x, b.y};
+    ball->velocity = (Point){b.vx, b.vy};
+    return contacts;
 }
 
-// Function to check collision with the hexagon walls
-void check_collision(Ball* ball, Point center, double size, double angle) {
-    for (int i = 0; i < 6; i++) {
-        double a = angle + i * M_PI / 3;
-        Point vertex1 = {center.x + size * cos(a), center.y + size * sin(a)};
-        double a_next = angle + (i + 1) % 6 * M_PI / 3;
-        Point vertex2 = {center.x + size * cos(a_next), center.y + size * sin(a_next)};
-
-        // Calculate the normal vector of the wall
-        Point normal = {vertex2.y - vertex1.y, vertex1.x - vertex2.x};
-        double length = sqrt(normal.x * normal.x + normal.y * normal.y);
-        normal.x /= length;
-        normal.y /= length;
-
-        // Check if the ball is colliding with the wall
-        double distance = (ball->position.x - vertex1.x) * normal.x + (ball->position.y - vertex1.y) * normal.y;
-        if (distance < BALL_SIZE / 2) {
-            // Calculate the reflection vector
-            double dot_product = ball->velocity.x * normal.x + ball->velocity.y * normal.y;
-            ball->velocity.x -= 2 * dot_product * normal.x * FRICTION;
-            ball->velocity.y -= 2 * dot_product * normal.y * FRICTION;
-
-            // Move the ball to the correct position after collision
-            ball->position.x -= distance * normal.x;
-            ball->position.y -= distance * normal.y;
+void usage(const char* prog) {
+    fprintf(stderr, "usage: %s [--integrator euler|verlet|rk4] [--keep-energy]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--integrator") == 0 && i + 1 < argc) {
+            if (!hc_integrator_parse(argv[++i], &physics.integrator)) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--keep-energy") == 0) {
+            physics.keep_energy = 1;
+        } else {
+            usage(argv[0]);
+            return 1;
         }
     }
-}
 
-int main() {
-    Display* display = create_window();
+    Window window;
+    Display* display = create_window(&window);
     int screen = DefaultScreen(display);
-    Window window = RootWindow(display, screen);
     GC gc = DefaultGC(display, screen);
 
+    // Draw into a back buffer and swap whole frames
+    Presenter present;
+    present_init(&present, display, window);
+
     // Initialize the ball
     Ball ball;
     ball.position.x = WIDTH / 2;
     ball.position.y = HEIGHT / 2;
-    ball.velocity.x = 2;
-    ball.velocity.y = -5;
+    ball.velocity.x = 120;
+    ball.velocity.y = -300;
 
     // Initialize the hexagon
     Point center = {WIDTH / 2, HEIGHT / 2};
     double size = HEXAGON_SIZE;
     double angle = 0;
+    HcShape hexagon;
+    if (!hc_shape_init(&hexagon, 6, center, size, 0)) {
+        fprintf(stderr, "Failed to allocate the hexagon\n");
+        exit(1);
+    }
+
+    Pacer pacer;
+    pacer_init(&pacer, FRAME_RATE);
+    EventLoop loop;
+    evloop_init(&loop, display);
+    // Frames the pacer has dropped so far; each is made up with a step
+    uint64_t dropped = 0;
 
     while (1) {
+        // Sleep until input arrives or the next frame is due
+        int frame = evloop_wait(&loop, &pacer);
+
         // Handle events
         XEvent event;
         while (XPending(display)) {
             XNextEvent(display, &event);
             if (event.type == KeyPress) {
+                pacer_report(&pacer, stderr);
+                evloop_report(&loop, stderr);
+                evloop_destroy(&loop);
+                present_report(&present, stderr);
+                present_destroy(&present);
+                hc_shape_free(&hexagon);
                 return 0;
             }
         }
-
-        // Update the ball's position and velocity
-        update_ball(&ball);
-
-        // Check collision with the hexagon walls
-        check_collision(&ball, center, size, angle);
-
-        // Update the hexagon's angle
-        angle += 0.01;
+        if (!frame)
+            continue;
+
+        // Step DT for this frame and for every frame dropped since the
+        // last one, so simulated time keeps up with the wall clock
+        uint64_t steps = 1 + pacer.skipped - dropped;
+        dropped = pacer.skipped;
+        for (uint64_t i = 0; i < steps; i++) {
+            // Update the ball against the hexagon walls
+            hc_shape_update(&hexagon, angle);
+            update_ball(&ball, &hexagon, DT);
+
+            // Update the hexagon's angle
+            angle += ROTATION_SPEED * DT;
+        }
 
         // Clear the window
-        XClearWindow(display, window);
+        present_begin(&present);
 
         // Draw the hexagon
-        draw_hexagon(display, window, gc, center, size, angle);
+        draw_hexagon(display, present.target, gc, center, size, angle);
 
         // Draw the ball
-        XFillArc(display, window, gc, (int)(ball.position.x - BALL_SIZE / 2), (int)(ball.position.y - BALL_SIZE / 2), BALL_SIZE, BALL_SIZE, 0, 360 * 64);
-
-        // Flush the display
-        XFlush(display);
+        XFillArc(display, present.target, gc, (int)(ball.position.x - BALL_SIZE / 2), (int)(ball.position.y - BALL_SIZE / 2), BALL_SIZE, BALL_SIZE, 0, 360 * 64);
 
-        // Cap the frame rate
-        usleep(16000); // 60 FPS
+        // Show the frame
+        present_swap(&present);
     }
 
     return 0;
 }
+
+#ifdef BALLHEX_BENCH
+#include "bench/bench.h"
+
+typedef struct {
+    Ball ball;
+    HcShape hexagon;
+    double angle;
+} BenchState;
+
+static void* bench_init(const BenchScenario* sc) {
+    BenchState* st = malloc(sizeof(*st));
+    Point center = {WIDTH / 2, HEIGHT / 2};
+    if (!st || !hc_shape_init(&st->hexagon, 6, center, HEXAGON_SIZE, 0)) {
+        free(st);
+        return NULL;
+    }
+    st->ball.position = (Point){center.x + sc->x * HEXAGON_SIZE, center.y + sc->y * HEXAGON_SIZE};
+    st->ball.velocity = (Point){sc->vx * HEXAGON_SIZE / DT, sc->vy * HEXAGON_SIZE / DT};
+    st->angle = 0;
+    return st;
+}
+
+static int bench_step(void* state) {
+    BenchState* st = state;
+    hc_shape_update(&st->hexagon, st->angle);
+    st->angle += ROTATION_SPEED * DT;
+    return update_ball(&st->ball, &st->hexagon, DT);
+}
+
+static void bench_fini(void* state) {
+    BenchState* st = state;
+    hc_shape_free(&st->hexagon);
+    free(st);
+}
+
+const BenchModel bench_model = {"l4m", bench_init, bench_step, bench_fini};
+#endif
@@ -4,29 +4,52 @@
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#include "common/damage.h"
+#include "common/eventloop.h"
+#include "common/pacer.h"
+#include "o4mphysics.h"
 
 #define WIDTH           800
 #define HEIGHT          600
-#define HEX_RADIUS      200.0
-#define BALL_RADIUS     20.0
-#define GRAVITY         980.0   /* px/s² */
-#define RESTITUTION     0.8
-#define FRICTION_COEF   0.2
-#define ANGULAR_VELOCITY 0.5    /* rad/s */
-#define FRAME_RATE      60
-
-int main() {
+
+static const HcPolicy physics =
+    O4M_POLICY(GRAVITY, RESTITUTION, FRICTION_COEF);
+
+static int step_ball(HcShape *hex, HcBall *ball, double angle, double dt) {
+    return o4m_step(&physics, hex, ball, angle, dt);
+}
+
+/* Screen position of a point: rotated out of the hexagon's frame when the
+   ball is solved in it, as of the last hc_frame_sync() */
+static Vec2 to_screen(const HcFrame *frame, Vec2 p) {
+    return frame ? hc_frame_point(frame, p) : p;
+}
+
+int main(int argc, char **argv) {
     Display *dpy;
     int screen;
     Window win;
     GC gc;
     Pixmap buffer;
     XEvent ev;
-    double hx[6], hy[6];
-    double bx, by, vx, vy;
+    HcShape hex;
+    HcBall ball;
     double angle = 0.0;
     double cx = WIDTH / 2.0, cy = HEIGHT / 2.0;
-    struct timespec req = {0, (long)(1e9 / FRAME_RATE)};
+    Pacer pacer;
+    HcFrame frame;
+    HcFrame *rotating = NULL;  /* non-NULL: solve in the hexagon's frame */
+    Damage damage;
+    EventLoop loop;
+
+    if (argc == 2 && strcmp(argv[1], "--rotating-frame") == 0) {
+        rotating = &frame;
+    } else if (argc > 1) {
+        fprintf(stderr, "usage: %s [--rotating-frame]\n", argv[0]);
+        exit(1);
+    }
 
     dpy = XOpenDisplay(NULL);
     if (!dpy) {
@@ -50,113 +73,140 @@ int main() {
         DefaultDepth(dpy, screen)
     );
 
-    /* Precompute unrotated hexagon vertices */
-    for (int i = 0; i < 6; ++i) {
-        double theta = 2.0 * M_PI * i / 6.0;
-        hx[i] = HEX_RADIUS * cos(theta);
-        hy[i] = HEX_RADIUS * sin(theta);
+    /* Precompute unrotated hexagon vertices; in the rotating frame they
+       never move */
+    if (!hc_shape_init(&hex, 6, (Vec2){cx, cy}, HEX_RADIUS,
+                       rotating ? 0.0 : ANGULAR_VELOCITY)) {
+        fprintf(stderr, "Cannot allocate hexagon\n");
+        exit(1);
     }
 
     /* Ball starts at center, at rest */
-    bx = cx;  by = cy;
-    vx = vy = 0.0;
+    ball = (HcBall){cx, cy, 0.0, 0.0};
+    if (rotating) {
+        hc_frame_init(rotating, &physics, (Vec2){cx, cy}, ANGULAR_VELOCITY,
+                      angle, 1.0 / FRAME_RATE);
+        ball = hc_frame_from_world(rotating, ball);
+    }
+
+    damage_init(&damage, WIDTH, HEIGHT);
+    pacer_init(&pacer, FRAME_RATE);
+    evloop_init(&loop, dpy);
 
     while (1) {
+        /* Sleep until input arrives or the next frame is due */
+        int frame = evloop_wait(&loop, &pacer);
+
         /* Handle keypress to exit */
         while (XPending(dpy)) {
             XNextEvent(dpy, &ev);
             if (ev.type == KeyPress) goto cleanup;
+            if (ev.type == Expose) damage_invalidate(&damage);
         }
+        if (!frame) continue;
 
         double dt = 1.0 / FRAME_RATE;
-        /* Physics update */
-        vy += GRAVITY * dt;
-        bx += vx * dt;
-        by += vy * dt;
-
-        /* Compute rotated hexagon in screen coords */
-        double px[6], py[6];
-        for (int i = 0; i < 6; ++i) {
-            double rx = hx[i] * cos(angle)
-                      - hy[i] * sin(angle);
-            double ry = hx[i] * sin(angle)
-                      + hy[i] * cos(angle);
-            px[i] = cx + rx;
-            py[i] = cy + ry;
+        /* Physics update against the hexagon at the current angle */
+        if (rotating) {
+            hc_frame_step(&physics, rotating, &hex, &ball, BALL_RADIUS);
+            hc_frame_sync(rotating);
+        } else {
+            step_ball(&hex, &ball, angle, dt);
+            angle += ANGULAR_VELOCITY * dt;
         }
 
-        /* Collision with each hexagon edge */
-        for (int i = 0; i < 6; ++i) {
-            int j = (i + 1) % 6;
-            double dx = px[j] - px[i];
-            double dy = py[j] - py[i];
-            double len = sqrt(dx*dx + dy*dy);
-            double tx = dx / len, ty = dy / len;
-            /* inward normal (left-hand perp for CCW) */
-            double nx = ty, ny = -tx;
-
-            double fx = bx - px[i], fy = by - py[i];
-            double proj_t = fx*tx + fy*ty;
-            /* only if foot falls within segment */
-            if (proj_t < 0 || proj_t > len) continue;
-
-            double proj_n = fx*nx + fy*ny;
-            if (proj_n < BALL_RADIUS) {
-                /* push ball out of wall */
-                double pen = BALL_RADIUS - proj_n;
-                bx += pen * nx;
-                by += pen * ny;
-                /* decompose velocity */
-                double v_n = vx*nx + vy*ny;
-                double v_t = vx*tx + vy*ty;
-                /* reflect normal with restitution */
-                v_n = -RESTITUTION * v_n;
-                /* reduce tangential by friction */
-                v_t *= (1.0 - FRICTION_COEF);
-                /* reassemble */
-                vx = v_n*nx + v_t*tx;
-                vy = v_n*ny + v_t*ty;
-            }
+        /* Lay out the hexagon and ball, noting their bounds */
+        XPoint hull[7];
+        double min_x = WIDTH, min_y = HEIGHT, max_x = 0, max_y = 0;
+        for (int i = 0; i < 7; ++i) {
+            Vec2 v = to_screen(rotating, (Vec2){hex.vx[i % 6], hex.vy[i % 6]});
+            hull[i].x = (short)v.x;
+            hull[i].y = (short)v.y;
+            min_x = fmin(min_x, v.x);
+            min_y = fmin(min_y, v.y);
+            max_x = fmax(max_x, v.x);
+            max_y = fmax(max_y, v.y);
         }
-
-        angle += ANGULAR_VELOCITY * dt;
-
-        /* Draw to off-screen pixmap */
-        XSetForeground(dpy, gc, WhitePixel(dpy, screen));
-        XFillRectangle(dpy, buffer, gc, 0, 0, WIDTH, HEIGHT);
-
-        XSetForeground(dpy, gc, BlackPixel(dpy, screen));
-        /* Hexagon edges */
-        for (int i = 0; i < 6; ++i) {
-            int j = (i + 1) % 6;
-            XDrawLine(
+        damage_add(&damage, min_x, min_y, max_x, max_y);
+        Vec2 pos = to_screen(rotating, (Vec2){ball.x, ball.y});
+        int bx_i = (int)(pos.x - BALL_RADIUS);
+        int by_i = (int)(pos.y - BALL_RADIUS);
+        int dia = (int)(2 * BALL_RADIUS);
+        damage_add(&damage, bx_i, by_i, bx_i + dia, by_i + dia);
+
+        /* Redraw and blit only what changed since the last frame */
+        if (damage_begin(&damage, dpy, gc)) {
+            XSetForeground(dpy, gc, WhitePixel(dpy, screen));
+            XFillRectangle(dpy, buffer, gc, 0, 0, WIDTH, HEIGHT);
+
+            XSetForeground(dpy, gc, BlackPixel(dpy, screen));
+            /* Hexagon edges */
+            XDrawLines(dpy, buffer, gc, hull, 7, CoordModeOrigin);
+            /* Ball */
+            XFillArc(
                 dpy, buffer, gc,
-                (int)px[i], (int)py[i],
-                (int)px[j], (int)py[j]
+                bx_i, by_i, dia, dia,
+                0, 360*64
+            );
+
+            /* Blit to window */
+            XCopyArea(
+                dpy, buffer, win, gc,
+                0, 0, WIDTH, HEIGHT, 0, 0
             );
+            damage_end(dpy, gc);
+            XFlush(dpy);
         }
-        /* Ball */
-        int bx_i = (int)(bx - BALL_RADIUS);
-        int by_i = (int)(by - BALL_RADIUS);
-        int dia = (int)(2 * BALL_RADIUS);
-        XFillArc(
-            dpy, buffer, gc,
-            bx_i, by_i, dia, dia,
-            0, 360*64
-        );
-
-        /* Blit to window */
-        XCopyArea(
-            dpy, buffer, win, gc,
-            0, 0, WIDTH, HEIGHT, 0, 0
-        );
-        XFlush(dpy);
-
-        nanosleep(&req, NULL);
     }
 
 cleanup:
+    pacer_report(&pacer, stderr);
+    evloop_report(&loop, stderr);
+    evloop_destroy(&loop);
+    damage_report(&damage, stderr);
+    hc_shape_free(&hex);
     XFreePixmap(dpy, buffer);
     XCloseDisplay(dpy);
     return 0;
 }
+
+#ifdef BALLHEX_BENCH
+#include "bench/bench.h"
+
+typedef struct {
+    HcShape hex;
+    HcBall ball;
+    double angle;
+} BenchState;
+
+static void *bench_init(const BenchScenario *sc) {
+    BenchState *st = malloc(sizeof(*st));
+    double cx = WIDTH / 2.0, cy = HEIGHT / 2.0;
+    double dt = 1.0 / FRAME_RATE;
+    if (!st || !hc_shape_init(&st->hex, 6, (Vec2){cx, cy}, HEX_RADIUS,
+                              ANGULAR_VELOCITY)) {
+        free(st);
+        return NULL;
+    }
+    st->ball = (HcBall){cx + sc->x * HEX_RADIUS, cy + sc->y * HEX_RADIUS,
+                        sc->vx * HEX_RADIUS / dt, sc->vy * HEX_RADIUS / dt};
+    st->angle = 0.0;
+    return st;
+}
+
+static int bench_step(void *state) {
+    BenchState *st = state;
+    double dt = 1.0 / FRAME_RATE;
+    int contacts = step_ball(&st->hex, &st->ball, st->angle, dt);
+    st->angle += ANGULAR_VELOCITY * dt;
+    return contacts;
+}
+
+static void bench_fini(void *state) {
+    BenchState *st = state;
+    hc_shape_free(&st->hex);
+    free(st);
+}
+
+const BenchModel bench_model = {"o4m", bench_init, bench_step, bench_fini};
+#endif
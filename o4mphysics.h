@@ -0,0 +1,49 @@
+#ifndef O4MPHYSICS_H
+#define O4MPHYSICS_H
+
+#include "core/hexcore.h"
+
+#define HEX_RADIUS      200.0
+#define BALL_RADIUS     20.0
+#define GRAVITY         980.0   /* px/s² */
+#define RESTITUTION     0.8
+#define FRICTION_COEF   0.2
+#define ANGULAR_VELOCITY 0.5    /* rad/s */
+#define FRAME_RATE      60
+
+/* The constants above as runtime values, for tools that vary them */
+typedef struct {
+    double gravity;
+    double restitution;
+    double friction;
+    double omega;
+} O4mParams;
+
+static const O4mParams o4m_defaults = {
+    GRAVITY, RESTITUTION, FRICTION_COEF, ANGULAR_VELOCITY
+};
+
+/* Bounce off an edge only where the ball's foot falls within it. A
+   constant expression for constant arguments. */
+#define O4M_POLICY(gravity_, restitution_, friction_) { \
+    .gravity = (gravity_),                                \
+    .test = HC_TEST_FOOT,                                 \
+    .push = HC_PUSH_OUT,                                  \
+    .response = HC_RESPONSE_SCALE,                        \
+    .restitution = (restitution_),                        \
+    .tangent_keep = 1.0 - (friction_),                    \
+}
+
+static inline HcPolicy o4m_policy(const O4mParams *p) {
+    return (HcPolicy)O4M_POLICY(p->gravity, p->restitution, p->friction);
+}
+
+/* Advance the ball one step against the hexagon at the given angle;
+   returns the number of walls it bounced off */
+static inline int o4m_step(const HcPolicy *policy, HcShape *hex,
+                           HcBall *ball, double angle, double dt) {
+    hc_shape_update(hex, angle);
+    return hc_step(policy, hex, ball, BALL_RADIUS, dt);
+}
+
+#endif
@@ -2,6 +2,12 @@
 #include <math.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/eventloop.h"
+#include "common/pacer.h"
+#include "core/hexcore.h"
 
 #define WIDTH 600
 #define HEIGHT 600
@@ -10,64 +16,76 @@
 #define GRAVITY 0.5
 #define FRICTION 0.9
 #define DT 0.016 // ~60 FPS
-
-typedef struct {
-    double x, y;
-} Point;
-
-Point original_hex[6];
-Point rotated_hex[6];
+#define SPIN 0.01 // Rotation per frame
+
+typedef Vec2 Point;
+
+// Bounce off the first wall within BALL_RADIUS of the ball, on either side
+static const HcPolicy physics = {
+    .gravity = GRAVITY,
+    .test = HC_TEST_LINE_ABS,
+    .push = HC_PUSH_NONE,
+    .response = HC_RESPONSE_SCALE,
+    .restitution = 1 + 2 * FRICTION,
+    .tangent_keep = 1,
+    .first_hit_only = 1,
+};
+
+HcShape hex;
 Point ball = { 0.0, 0.0 };
 double ball_vel[2] = { 5.0, 0.0 };
 double phi = 0.0;
 
+// With use_frame the ball lives in the hexagon's rotating frame and the
+// hexagon stays at angle 0; it is only turned for drawing
+int use_frame = 0;
+HcFrame frame;
+
 Display *dpy;
 Window win;
 GC gc;
 
 void init_hex() {
-    for (int i = 0; i < 6; i++) {
-        double angle = 2 * M_PI * i / 6;
-        original_hex[i].x = HEX_RADIUS * cos(angle);
-        original_hex[i].y = HEX_RADIUS * sin(angle);
-    }
+    if (!hc_shape_init(&hex, 6, (Point){ 0.0, 0.0 }, HEX_RADIUS, 0.0))
+        exit(1);
 }
 
 void rotate_hex(double angle) {
-    double cos_a = cos(angle);
-    double sin_a = sin(angle);
-    for (int i = 0; i < 6; i++) {
-        double x = original_hex[i].x;
-        double y = original_hex[i].y;
-        rotated_hex[i].x = x * cos_a - y * sin_a;
-        rotated_hex[i].y = x * sin_a + y * cos_a;
-    }
+    hc_shape_update(&hex, angle);
 }
 
-void handle_collision() {
-    for (int i = 0; i < 6; i++) {
-        Point v0 = rotated_hex[i];
-        Point v1 = rotated_hex[(i+1)%6];
-        double dx = v1.x - v0.x;
-        double dy = v1.y - v0.y;
-        double px = ball.x - v0.x;
-        double py = ball.y - v0.y;
-        double cross = dx * py - dy * px;
-        double length = sqrt(dx*dx + dy*dy);
-        if (length == 0) continue;
-        double dist = cross / length;
-        if (fabs(dist) < BALL_RADIUS) {
-            double nx = dy / length;
-            double ny = -dx / length;
-            double v_dot_n = ball_vel[0] * nx + ball_vel[1] * ny;
-            ball_vel[0] -= 2 * v_dot_n * nx * (1 + FRICTION);
-            ball_vel[1] -= 2 * v_dot_n * ny * (1 + FRICTION);
-            break;
-        }
+int update_ball() {
+    HcBall b = { ball.x, ball.y, ball_vel[0], ball_vel[1] };
+    int contacts;
+    if (use_frame) {
+        contacts = hc_frame_step(&physics, &frame, &hex, &b, BALL_RADIUS);
+        phi = frame.angle;
+    } else {
+        contacts = hc_step(&physics, &hex, &b, BALL_RADIUS, DT);
     }
+    ball = (Point){ b.x, b.y };
+    ball_vel[0] = b.vx;
+    ball_vel[1] = b.vy;
+    return contacts;
 }
 
-int main() {
+void enter_frame() {
+    hc_frame_init(&frame, &physics, (Point){ 0.0, 0.0 }, SPIN / DT, phi, DT);
+    HcBall b = hc_frame_from_world(&frame,
+                                   (HcBall){ ball.x, ball.y, ball_vel[0], ball_vel[1] });
+    ball = (Point){ b.x, b.y };
+    ball_vel[0] = b.vx;
+    ball_vel[1] = b.vy;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "--rotating-frame") == 0) {
+        use_frame = 1;
+    } else if (argc > 1) {
+        fprintf(stderr, "usage: %s [--rotating-frame]\n", argv[0]);
+        return 1;
+    }
+
     dpy = XOpenDisplay(NULL);
     win = XCreateSimpleWindow(dpy, RootWindow(dpy, 0), 0, 0, WIDTH, HEIGHT, 0, 0, 0);
     gc = XCreateGC(dpy, win, 0, NULL);
@@ -75,8 +93,18 @@ int main() {
     XMapWindow(dpy, win);
 
     init_hex();
+    if (use_frame)
+        enter_frame();
+
+    Pacer pacer;
+    pacer_init(&pacer, 1.0 / DT);
+    EventLoop loop;
+    evloop_init(&loop, dpy);
 
     while (1) {
+        // Sleep until input arrives or the next frame is due
+        int frame_due = evloop_wait(&loop, &pacer);
+
         XEvent e;
         while (XPending(dpy)) {
             XNextEvent(dpy, &e);
@@ -84,39 +112,78 @@ int main() {
                 // Handle resize
             }
             if (e.type == ClientMessage || e.type == DestroyNotify) {
+                pacer_report(&pacer, stderr);
+                evloop_report(&loop, stderr);
+                evloop_destroy(&loop);
+                hc_shape_free(&hex);
                 exit(0);
             }
         }
+        if (!frame_due)
+            continue;
 
         // Physics update
-        ball_vel[1] += GRAVITY * DT;
-        ball.x += ball_vel[0] * DT;
-        ball.y += ball_vel[1] * DT;
-
-        handle_collision();
-
-        phi += 0.01; // Rotation speed
+        update_ball();
 
         // Draw
         XClearWindow(dpy, win);
-        rotate_hex(phi);
+        Point pos = ball;
+        if (use_frame) {
+            hc_frame_sync(&frame);
+            pos = hc_frame_point(&frame, ball);
+        } else {
+            phi += SPIN; // Rotation speed
+            rotate_hex(phi);
+        }
 
         // Draw hexagon
         XPoint hex_points[6];
         for (int i = 0; i < 6; i++) {
-            hex_points[i].x = rotated_hex[i].x + WIDTH/2;
-            hex_points[i].y = rotated_hex[i].y + HEIGHT/2;
+            Point v = { hex.vx[i], hex.vy[i] };
+            if (use_frame)
+                v = hc_frame_point(&frame, v);
+            hex_points[i].x = v.x + WIDTH/2;
+            hex_points[i].y = v.y + HEIGHT/2;
         }
         XDrawLines(dpy, win, gc, hex_points, 6, CoordModeOrigin);
 
         // Draw ball
-        int x = ball.x + WIDTH/2 - BALL_RADIUS;
-        int y = ball.y + HEIGHT/2 - BALL_RADIUS;
+        int x = pos.x + WIDTH/2 - BALL_RADIUS;
+        int y = pos.y + HEIGHT/2 - BALL_RADIUS;
         XFillArc(dpy, win, gc, x, y, 2*BALL_RADIUS, 2*BALL_RADIUS, 0, 360*64);
 
         XFlush(dpy);
-        usleep(16); // ~60 FPS
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+#ifdef BALLHEX_BENCH
+#include "bench/bench.h"
+
+// The model keeps its scene in globals, so there is no separate state
+static void *bench_init(const BenchScenario *sc) {
+    init_hex();
+    rotate_hex(0.0);
+    phi = 0.0;
+    ball = (Point){ sc->x * HEX_RADIUS, sc->y * HEX_RADIUS };
+    ball_vel[0] = sc->vx * HEX_RADIUS / DT;
+    ball_vel[1] = sc->vy * HEX_RADIUS / DT;
+    return &ball;
+}
+
+static int bench_step(void *state) {
+    (void)state;
+    int contacts = update_ball();
+    phi += SPIN;
+    rotate_hex(phi);
+    return contacts;
+}
+
+static void bench_fini(void *state) {
+    (void)state;
+    hc_shape_free(&hex);
+}
+
+const BenchModel bench_model = { "qwq", bench_init, bench_step, bench_fini };
+#endif
@@ -0,0 +1,334 @@
+// Ensemble runner: simulates many independent ball-in-hexagon scenes with the
+// g4ballhex physics and writes one result row per scene.
+//
+// Scenes are read as CSV lines "vx,vy,restitution,mu" (blank lines and lines
+// starting with '#' are ignored). Every scene starts with the ball at the
+// hexagon centre and runs for the same simulated duration. Scenes are spread
+// over a work-stealing pool with one worker per online CPU.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "g4physics.h"
+
+#define DEFAULT_DURATION 60.0 // simulated seconds per scene
+#define CACHE_LINE 64
+
+typedef struct {
+  double vx, vy;
+  double restitution, mu;
+} Scene;
+
+typedef struct {
+  Ball ball;
+  long contacts;
+  double max_speed;
+} Result;
+
+// Each worker owns a contiguous range [head, tail) of scene indices packed
+// into one atomic word. The owner pops from the head; thieves take the upper
+// half of the range. Both go through compare-and-swap, so one scene can
+// never be claimed twice.
+typedef struct {
+  _Alignas(CACHE_LINE) _Atomic uint64_t range;
+  long scenes_run;
+  long steals;
+} WorkQueue;
+
+typedef struct {
+  const Scene *scenes;
+  Result *results;
+  WorkQueue *queues;
+  int num_workers;
+  long steps;
+} Pool;
+
+typedef struct {
+  Pool *pool;
+  int id;
+} Worker;
+
+static uint64_t pack_range(uint32_t head, uint32_t tail) {
+  return (uint64_t)head << 32 | tail;
+}
+
+static long pop_local(WorkQueue *q) {
+  uint64_t r = atomic_load(&q->range);
+  for (;;) {
+    uint32_t head = r >> 32, tail = (uint32_t)r;
+    if (head >= tail)
+      return -1;
+    if (atomic_compare_exchange_weak(&q->range, &r, pack_range(head + 1, tail)))
+      return head;
+  }
+}
+
+// Move the upper half of a victim's range into the thief's (empty) queue
+static int steal(WorkQueue *thief, WorkQueue *victim) {
+  uint64_t r = atomic_load(&victim->range);
+  for (;;) {
+    uint32_t head = r >> 32, tail = (uint32_t)r;
+    if (head >= tail)
+      return 0;
+    uint32_t take = (tail - head + 1) / 2;
+    if (atomic_compare_exchange_weak(&victim->range, &r,
+                                     pack_range(head, tail - take))) {
+      atomic_store(&thief->range, pack_range(tail - take, tail));
+      thief->steals++;
+      return 1;
+    }
+  }
+}
+
+static void run_scene(const Scene *scene, Result *result, HcShape *hex,
+                      long steps) {
+  HcPolicy policy = g4_policy(&g4_defaults, scene->restitution, scene->mu);
+  Ball ball = {0, 0, scene->vx, scene->vy};
+  double time = 0.0;
+  long contacts = 0;
+  double max_speed2 = 0.0;
+
+  for (long i = 0; i < steps; i++) {
+    time += DT;
+    turn_hexagon(&policy, hex, OMEGA * time);
+    contacts += step_ball(&policy, &ball, hex);
+    double speed2 = ball.vx * ball.vx + ball.vy * ball.vy;
+    if (speed2 > max_speed2)
+      max_speed2 = speed2;
+  }
+
+  result->ball = ball;
+  result->contacts = contacts;
+  result->max_speed = sqrt(max_speed2);
+}
+
+static void *worker_main(void *arg) {
+  Worker *w = arg;
+  Pool *pool = w->pool;
+  WorkQueue *self = &pool->queues[w->id];
+  HcShape hex;
+
+  // Every scene's hexagon is centred on the origin
+  if (!init_hexagon(&hex, (Point){0, 0})) {
+    fprintf(stderr, "worker %d: out of memory\n", w->id);
+    exit(1);
+  }
+  for (;;) {
+    long i = pop_local(self);
+    if (i >= 0) {
+      run_scene(&pool->scenes[i], &pool->results[i], &hex, pool->steps);
+      self->scenes_run++;
+      continue;
+    }
+    // No scenes are ever added, so once every queue is empty we are done
+    int stolen = 0;
+    for (int k = 1; k < pool->num_workers && !stolen; k++)
+      stolen = steal(self, &pool->queues[(w->id + k) % pool->num_workers]);
+    if (!stolen)
+      break;
+  }
+  hc_shape_free(&hex);
+  return NULL;
+}
+
+static int read_scenes(FILE *in, Scene **out, long *count) {
+  long cap = 1024, n = 0;
+  Scene *scenes = malloc(cap * sizeof(Scene));
+  char line[256];
+  long lineno = 0;
+
+  if (!scenes)
+    return 0;
+  while (fgets(line, sizeof(line), in)) {
+    lineno++;
+    char *p = line + strspn(line, " \t");
+    if (*p == '#' || *p == '\n' || *p == '\0')
+      continue;
+    Scene s;
+    if (sscanf(p, "%lf,%lf,%lf,%lf", &s.vx, &s.vy, &s.restitution, &s.mu) !=
+        4) {
+      fprintf(stderr, "line %ld: expected vx,vy,restitution,mu\n", lineno);
+      free(scenes);
+      return 0;
+    }
+    if (n == cap) {
+      Scene *grown = realloc(scenes, 2 * cap * sizeof(Scene));
+      if (!grown) {
+        free(scenes);
+        return 0;
+      }
+      scenes = grown;
+      cap *= 2;
+    }
+    scenes[n++] = s;
+  }
+  *out = scenes;
+  *count = n;
+  return 1;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-t threads] [-d seconds] [-p] [-o output.csv] "
+          "[scenes.csv]\n"
+          "  -t N  worker threads (default: online CPUs)\n"
+          "  -d S  simulated seconds per scene (default: %.0f)\n"
+          "  -p    pin worker i to the i-th allowed CPU\n"
+          "  -o F  write results to F instead of stdout\n",
+          prog, DEFAULT_DURATION);
+}
+
+int main(int argc, char **argv) {
+  int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  double duration = DEFAULT_DURATION;
+  int pin = 0;
+  const char *out_path = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "t:d:po:h")) != -1) {
+    switch (opt) {
+    case 't':
+      num_workers = atoi(optarg);
+      break;
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 'p':
+      pin = 1;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (num_workers < 1 || duration <= 0 || optind + 1 < argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *in = stdin;
+  if (optind < argc && !(in = fopen(argv[optind], "r"))) {
+    fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  Scene *scenes;
+  long num_scenes;
+  if (!read_scenes(in, &scenes, &num_scenes))
+    return 1;
+  if (in != stdin)
+    fclose(in);
+  if (num_scenes > UINT32_MAX) {
+    fprintf(stderr, "too many scenes\n");
+    return 1;
+  }
+
+  Pool pool = {
+      .scenes = scenes,
+      .results = calloc(num_scenes ? num_scenes : 1, sizeof(Result)),
+      .queues = aligned_alloc(CACHE_LINE, num_workers * sizeof(WorkQueue)),
+      .num_workers = num_workers,
+      .steps = (long)(duration / DT + 0.5),
+  };
+  Worker *workers = malloc(num_workers * sizeof(Worker));
+  pthread_t *threads = malloc(num_workers * sizeof(pthread_t));
+  if (!pool.results || !pool.queues || !workers || !threads) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  // Deal the scenes out in equal contiguous slices; stealing evens out the
+  // imbalance from scenes that happen to be slower
+  for (int i = 0; i < num_workers; i++) {
+    uint32_t head = (uint32_t)(num_scenes * i / num_workers);
+    uint32_t tail = (uint32_t)(num_scenes * (i + 1) / num_workers);
+    atomic_init(&pool.queues[i].range, pack_range(head, tail));
+    pool.queues[i].scenes_run = 0;
+    pool.queues[i].steals = 0;
+  }
+
+  cpu_set_t allowed;
+  int num_allowed = 0;
+  if (pin) {
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+      num_allowed = CPU_COUNT(&allowed);
+    if (num_allowed == 0)
+      fprintf(stderr, "cannot query CPU affinity, not pinning\n");
+  }
+
+  double start = now();
+  for (int i = 0; i < num_workers; i++) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (num_allowed > 0) {
+      // Find the (i mod num_allowed)-th CPU in the allowed set
+      int want = i % num_allowed, cpu = 0;
+      for (int seen = -1; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &allowed) && ++seen == want)
+          break;
+      cpu_set_t one;
+      CPU_ZERO(&one);
+      CPU_SET(cpu, &one);
+      pthread_attr_setaffinity_np(&attr, sizeof(one), &one);
+    }
+    workers[i] = (Worker){&pool, i};
+    int err = pthread_create(&threads[i], &attr, worker_main, &workers[i]);
+    pthread_attr_destroy(&attr);
+    if (err) {
+      fprintf(stderr, "pthread_create: %s\n", strerror(err));
+      return 1;
+    }
+  }
+  for (int i = 0; i < num_workers; i++)
+    pthread_join(threads[i], NULL);
+  double elapsed = now() - start;
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+    return 1;
+  }
+  fprintf(out, "scene,vx0,vy0,restitution,mu,x,y,vx,vy,contacts,max_speed\n");
+  for (long i = 0; i < num_scenes; i++) {
+    const Scene *s = &scenes[i];
+    const Result *r = &pool.results[i];
+    fprintf(out, "%ld,%g,%g,%g,%g,%.6f,%.6f,%.6f,%.6f,%ld,%.6f\n", i, s->vx,
+            s->vy, s->restitution, s->mu, r->ball.x, r->ball.y, r->ball.vx,
+            r->ball.vy, r->contacts, r->max_speed);
+  }
+  if (out != stdout)
+    fclose(out);
+
+  double scene_steps = (double)num_scenes * pool.steps;
+  fprintf(stderr, "%ld scenes x %ld steps on %d workers%s in %.3f s "
+                  "(%.0f steps/sec)\n",
+          num_scenes, pool.steps, num_workers, num_allowed ? " (pinned)" : "",
+          elapsed, elapsed > 0 ? scene_steps / elapsed : 0.0);
+  for (int i = 0; i < num_workers; i++)
+    fprintf(stderr, "  worker %d: %ld scenes, %ld steals\n", i,
+            pool.queues[i].scenes_run, pool.queues[i].steals);
+
+  free(threads);
+  free(workers);
+  free(pool.queues);
+  free(pool.results);
+  free(scenes);
+  return 0;
+}
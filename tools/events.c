@@ -0,0 +1,241 @@
+// Event scheduler: long runs of many independent g4ballhex balls, each
+// flown from contact to contact instead of stepped by DT.
+//
+// Every ball keeps its own clock and plans its next event with
+// events_plan(): the next wall contact, the next output sample, or a run of
+// DT steps where contacts crowd together or prediction costs more than it
+// saves. A binary min-heap orders the
+// balls by the time of their next event, so the earliest one anywhere is
+// always taken next and the samples come out in time order. Each sample is a
+// CSV row "time,ball,x,y,vx,vy,energy". The same balls can also be stepped
+// by DT for comparison.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "g4physics.h"
+
+#define DEFAULT_DURATION 600.0 // simulated seconds
+#define DEFAULT_BALLS 100
+#define DEFAULT_INTERVAL 1.0 // simulated seconds between samples
+
+typedef struct {
+  Ball ball;
+  EventStepper ev;
+  long sample;    // index of the next sample to write
+  double until;   // time of that sample
+  long contacts;
+} Track;
+
+// Min-heap of track indices keyed by the time of each track's next event
+typedef struct {
+  int *slots;
+  int count;
+  const Track *tracks;
+} Schedule;
+
+static double cpu_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double due(const Schedule *s, int slot) {
+  return s->tracks[s->slots[slot]].ev.next;
+}
+
+// Move the entry at slot down until neither child is due earlier
+static void sift_down(Schedule *s, int slot) {
+  for (;;) {
+    int first = slot, left = 2 * slot + 1, right = left + 1;
+    if (left < s->count && due(s, left) < due(s, first))
+      first = left;
+    if (right < s->count && due(s, right) < due(s, first))
+      first = right;
+    if (first == slot)
+      return;
+    int swap = s->slots[slot];
+    s->slots[slot] = s->slots[first];
+    s->slots[first] = swap;
+    slot = first;
+  }
+}
+
+static void write_sample(FILE *out, double time, int index, const Ball *b) {
+  fprintf(out, "%.6f,%d,%.6f,%.6f,%.6f,%.6f,%.6f\n", time, index, b->x, b->y,
+          b->vx, b->vy, ball_energy(b));
+}
+
+// Sample time k, clamped to the end of the run
+static double sample_time(long k, double interval, double duration) {
+  return fmin(k * interval, duration);
+}
+
+static int run_events(Track *tracks, int count, HcShape *hex,
+                      double duration, double interval, FILE *out) {
+  HcPolicy policy = g4_policy(&g4_defaults, RESTITUTION, MU);
+  Schedule s = {malloc(count * sizeof(int)), count, tracks};
+  if (!s.slots)
+    return 0;
+
+  for (int i = 0; i < count; i++) {
+    Track *t = &tracks[i];
+    events_init(&t->ev, 0.0);
+    write_sample(out, 0.0, i, &t->ball);
+    t->sample = 1;
+    t->until = sample_time(1, interval, duration);
+    events_plan(&t->ev, &policy, &t->ball, hex, t->until);
+    s.slots[i] = i;
+  }
+  for (int slot = count / 2 - 1; slot >= 0; slot--)
+    sift_down(&s, slot);
+
+  // The earliest event is always at the root. Taking it moves that ball on
+  // to its next event, so only the root needs sifting back into place.
+  while (s.count > 0) {
+    int i = s.slots[0];
+    Track *t = &tracks[i];
+    t->contacts += events_take(&t->ev, &policy, &t->ball, hex);
+    if (t->ev.time >= t->until) {
+      write_sample(out, t->until, i, &t->ball);
+      if (t->until >= duration) {
+        s.slots[0] = s.slots[--s.count];
+        sift_down(&s, 0);
+        continue;
+      }
+      t->until = sample_time(++t->sample, interval, duration);
+    }
+    events_plan(&t->ev, &policy, &t->ball, hex, t->until);
+    sift_down(&s, 0);
+  }
+  free(s.slots);
+  return 1;
+}
+
+// Every ball stepped by DT for the same time, as g4ballhex does
+static long run_fixed(Ball *balls, int count, HcShape *hex, double duration) {
+  HcPolicy policy = g4_policy(&g4_defaults, RESTITUTION, MU);
+  long frames = (long)(duration / DT + 0.5), contacts = 0;
+  for (int i = 0; i < count; i++) {
+    for (long f = 1; f <= frames; f++) {
+      turn_hexagon(&policy, hex, OMEGA * f * DT);
+      contacts += step_ball(&policy, &balls[i], hex);
+    }
+  }
+  return contacts;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-d seconds] [-b balls] [-s interval] [-c] "
+          "[-o output.csv]\n"
+          "  -d S  simulated seconds (default: %.0f)\n"
+          "  -b N  balls (default: %d)\n"
+          "  -s S  simulated seconds between samples (default: %g)\n"
+          "  -c    also step the balls by DT and compare the cost\n"
+          "  -o F  write the samples to F instead of stdout\n",
+          prog, DEFAULT_DURATION, DEFAULT_BALLS, DEFAULT_INTERVAL);
+}
+
+int main(int argc, char **argv) {
+  double duration = DEFAULT_DURATION;
+  double interval = DEFAULT_INTERVAL;
+  int count = DEFAULT_BALLS;
+  int compare = 0;
+  const char *out_path = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:b:s:co:h")) != -1) {
+    switch (opt) {
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 'b':
+      count = atoi(optarg);
+      break;
+    case 's':
+      interval = atof(optarg);
+      break;
+    case 'c':
+      compare = 1;
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (!(duration > 0) || count < 1 || !(interval > 0) || optind < argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  Point center = {HEX_RADIUS, HEX_RADIUS};
+  HcShape hex;
+  Track *tracks = calloc(count, sizeof(Track));
+  Ball *start = malloc(count * sizeof(Ball));
+  Ball *fixed = compare ? malloc(count * sizeof(Ball)) : NULL;
+  if (!tracks || !start || (compare && !fixed) ||
+      !init_polygon(&hex, center, NUM_SIDES)) {
+    fprintf(stderr, "Cannot allocate %d balls\n", count);
+    return 1;
+  }
+  init_balls(start, count, center);
+  for (int i = 0; i < count; i++)
+    tracks[i].ball = start[i];
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+    return 1;
+  }
+  fprintf(out, "time,ball,x,y,vx,vy,energy\n");
+
+  double cpu = cpu_now();
+  if (!run_events(tracks, count, &hex, duration, interval, out)) {
+    fprintf(stderr, "Cannot allocate %d balls\n", count);
+    return 1;
+  }
+  cpu = cpu_now() - cpu;
+  if (out != stdout && fclose(out) != 0) {
+    fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+    return 1;
+  }
+
+  long evals = 0, impacts = 0, steps = 0, contacts = 0;
+  for (int i = 0; i < count; i++) {
+    evals += tracks[i].ev.evals;
+    impacts += tracks[i].ev.impacts;
+    steps += tracks[i].ev.steps;
+    contacts += tracks[i].contacts;
+  }
+  long frames = (long)(duration / DT + 0.5) * count;
+  fprintf(stderr,
+          "%d balls for %.0f s: %ld contacts, %ld solved exactly and %ld in "
+          "%ld DT steps\n",
+          count, duration, contacts, impacts, contacts - impacts, steps);
+  fprintf(stderr,
+          "events: %ld gap evaluations and %ld DT steps where stepping "
+          "takes %ld, %.3f s CPU\n",
+          evals, steps, frames, cpu);
+  if (compare) {
+    memcpy(fixed, start, count * sizeof(Ball));
+    double fixed_cpu = cpu_now();
+    long fixed_contacts = run_fixed(fixed, count, &hex, duration);
+    fixed_cpu = cpu_now() - fixed_cpu;
+    fprintf(stderr, "fixed: %ld contacts, %.3f s CPU (%.1fx the events)\n",
+            fixed_contacts, fixed_cpu, fixed_cpu / fmax(cpu, 1e-9));
+  }
+
+  hc_shape_free(&hex);
+  free(start);
+  free(fixed);
+  free(tracks);
+  return 0;
+}
@@ -0,0 +1,209 @@
+// Integrator benchmark: energy drift against CPU cost for each of the core's
+// integrators over a range of step lengths.
+//
+// Every run uses the g4ballhex physics with the walls held still and
+// perfectly elastic (restitution 1, no friction), so the exact motion keeps
+// each ball's energy constant and any change is integration or contact
+// error. A fixed set of balls is stepped for the same simulated duration at
+// every (integrator, keep_energy, dt) combination; one CSV row each gives
+// the CPU time per simulated second and the worst relative energy drift
+// seen, ready to plot drift against cost. A ball that tunnels out of the
+// hexagon is counted and stops there. The largest step with no escapes and
+// a drift within the tolerance is then reported for each integrator, with
+// and without keep_energy.
+//
+// Under constant gravity Verlet and RK4 fly the exact parabola, so without
+// keep_energy their drift is what pushing the ball out of a wall does to
+// its height. keep_energy gives that back after every contact, so the
+// drift left is the error of the flight between contacts: rounding for
+// Verlet and RK4, and Euler's first-order lag, which the pushes no longer
+// partly cancel. Their step is then limited by tunnelling, not drift.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "g4physics.h"
+
+#define DEFAULT_DURATION 60.0  // simulated seconds per run
+#define DEFAULT_BALLS 64
+#define DEFAULT_TOLERANCE 1e-3 // drift, relative to G * HEX_RADIUS
+#define DT_MIN (1.0 / 4096)
+#define DT_MAX (1.0 / 8)
+
+static const HcIntegrator integrators[] = {
+    HC_INTEGRATE_EULER,
+    HC_INTEGRATE_VERLET,
+    HC_INTEGRATE_RK4,
+};
+#define NUM_INTEGRATORS (sizeof(integrators) / sizeof(integrators[0]))
+
+typedef struct {
+  double cpu_per_second; // CPU seconds per simulated second, all balls
+  double max_drift;      // worst |E - E0| / (G * HEX_RADIUS) over the run
+  double final_drift;    // mean over the balls at the end of the run
+  long contacts;
+  int escaped; // balls that tunnelled out of the hexagon
+} RunResult;
+
+static double cpu_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Whether the ball's centre has crossed any edge line
+static int outside(const HcShape *hex, const Ball *ball) {
+  for (int i = 0; i < hex->sides; i++)
+    if ((ball->x - hex->vx[i]) * hex->nx[i] +
+            (ball->y - hex->vy[i]) * hex->ny[i] >
+        0)
+      return 1;
+  return 0;
+}
+
+static int run(HcIntegrator integrator, int keep_energy, double dt, int count,
+               double duration, RunResult *result) {
+  Point center = {HEX_RADIUS, HEX_RADIUS};
+  HcShape hex;
+  Ball *balls = malloc(count * sizeof(Ball));
+  double *start_energy = malloc(count * sizeof(double));
+  if (!balls || !start_energy || !hc_shape_init(&hex, NUM_SIDES, center,
+                                                HEX_RADIUS, 0.0)) {
+    free(balls);
+    free(start_energy);
+    return 0;
+  }
+  hc_shape_update(&hex, 0.0);
+
+  HcPolicy policy = g4_policy(&g4_defaults, 1.0, 0.0);
+  policy.integrator = integrator;
+  policy.keep_energy = keep_energy;
+  init_balls(balls, count, center);
+  for (int i = 0; i < count; i++)
+    start_energy[i] = ball_energy(&balls[i]);
+
+  double scale = G * HEX_RADIUS;
+  long steps = (long)(duration / dt + 0.5);
+  *result = (RunResult){0};
+  double start = cpu_now();
+  for (int i = 0; i < count; i++) {
+    for (long s = 0; s < steps; s++) {
+      result->contacts +=
+          hc_step(&policy, &hex, &balls[i], BALL_RADIUS, dt);
+      double drift = fabs(ball_energy(&balls[i]) - start_energy[i]) / scale;
+      if (drift > result->max_drift)
+        result->max_drift = drift;
+      if (outside(&hex, &balls[i])) {
+        result->escaped++;
+        break;
+      }
+    }
+    result->final_drift +=
+        fabs(ball_energy(&balls[i]) - start_energy[i]) / scale / count;
+  }
+  result->cpu_per_second = (cpu_now() - start) / (steps * dt);
+
+  hc_shape_free(&hex);
+  free(start_energy);
+  free(balls);
+  return 1;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-d seconds] [-b balls] [-e tolerance] [-o output.csv]\n"
+          "  -d S  simulated seconds per run (default: %.0f)\n"
+          "  -b N  balls per run (default: %d)\n"
+          "  -e T  acceptable energy drift, relative to G * HEX_RADIUS "
+          "(default: %g)\n"
+          "  -o F  write the table to F instead of stdout\n",
+          prog, DEFAULT_DURATION, DEFAULT_BALLS, DEFAULT_TOLERANCE);
+}
+
+int main(int argc, char **argv) {
+  double duration = DEFAULT_DURATION;
+  double tolerance = DEFAULT_TOLERANCE;
+  int count = DEFAULT_BALLS;
+  const char *out_path = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:b:e:o:h")) != -1) {
+    switch (opt) {
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 'b':
+      count = atoi(optarg);
+      break;
+    case 'e':
+      tolerance = atof(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (duration <= 0 || count < 1 || tolerance <= 0 || optind < argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (out_path && !(out = fopen(out_path, "w"))) {
+    fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+    return 1;
+  }
+  fprintf(out, "integrator,keep_energy,dt,cpu_ms_per_sim_s,max_drift,"
+               "final_drift,contacts,escaped\n");
+
+  double best_dt[NUM_INTEGRATORS][2] = {{0}};
+  double best_cost[NUM_INTEGRATORS][2] = {{0}};
+  for (size_t k = 0; k < NUM_INTEGRATORS; k++) {
+    for (int keep = 0; keep <= 1; keep++) {
+      for (double dt = DT_MIN; dt <= DT_MAX; dt *= 2) {
+        RunResult r;
+        if (!run(integrators[k], keep, dt, count, duration, &r)) {
+          fprintf(stderr, "Cannot allocate %d balls\n", count);
+          return 1;
+        }
+        fprintf(out, "%s,%d,%g,%.6f,%.6e,%.6e,%ld,%d\n",
+                hc_integrator_name(integrators[k]), keep, dt,
+                r.cpu_per_second * 1e3, r.max_drift, r.final_drift,
+                r.contacts, r.escaped);
+        if (r.max_drift <= tolerance && !r.escaped && dt > best_dt[k][keep]) {
+          best_dt[k][keep] = dt;
+          best_cost[k][keep] = r.cpu_per_second;
+        }
+      }
+    }
+  }
+  if (out != stdout && fclose(out) != 0) {
+    fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+    return 1;
+  }
+
+  fprintf(stderr,
+          "largest dt with drift <= %g and no escapes (%d balls, %.0f s):\n",
+          tolerance, count, duration);
+  for (size_t k = 0; k < NUM_INTEGRATORS; k++) {
+    for (int keep = 0; keep <= 1; keep++) {
+      const char *name = hc_integrator_name(integrators[k]);
+      const char *mode = keep ? "kept" : "free";
+      if (best_dt[k][keep] > 0)
+        fprintf(stderr,
+                "  %-7s energy %s: dt %g, %.3f ms CPU per simulated second\n",
+                name, mode, best_dt[k][keep], best_cost[k][keep] * 1e3);
+      else
+        fprintf(stderr, "  %-7s energy %s: none down to dt %g\n", name, mode,
+                DT_MIN);
+    }
+  }
+  return 0;
+}
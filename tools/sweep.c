@@ -0,0 +1,435 @@
+// Parameter sweep: runs the o4mballhex physics headless over every point of
+// a grid of physics parameters and streams one result row per point.
+//
+// Each range is given as NAME=MIN:MAX:COUNT, COUNT evenly spaced values from
+// MIN to MAX (NAME=VALUE for a single one), for gravity, restitution,
+// friction and omega; a parameter left out keeps its o4mballhex value. The
+// grid is their Cartesian product. Every point starts the ball at rest in
+// the centre of the hexagon and runs for the same simulated duration at the
+// viewer's frame rate. Points are handed out in batches to one worker per
+// online CPU.
+//
+// The results file doubles as the checkpoint. Each batch's rows are appended
+// and flushed as one write, and the file opens with a line describing the
+// sweep. Run the same command again after an interruption and the rows
+// already present are kept and skipped, and a row cut short by a kill is
+// dropped and run again. Rows come out in completion order; the index column
+// gives each one's place in the grid.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "o4mphysics.h"
+
+#define DEFAULT_DURATION 30.0 // simulated seconds per point
+#define DEFAULT_BATCH 64
+#define MAX_POINTS 100000000L
+#define ROW_MAX 160 // bytes per result row, generously
+#define LINE_MAX_LEN 1024
+
+// The ball is at rest once it moves with the hexagon (its speed relative to
+// the wall velocity where it sits) to within REST_SPEED for REST_HOLD. A
+// ball lying on a wall gains one step of gravity before each contact takes
+// it away again, so that much is allowed on top.
+#define REST_SPEED 5.0 // px/s
+#define REST_HOLD 1.0  // s
+
+#define NUM_PARAMS 4
+
+typedef struct {
+  const char *name;
+  double min, max;
+  int count;
+} Range;
+
+typedef struct {
+  double time_to_rest; // -1 if the ball never came to rest
+  long contacts;
+  double max_speed;
+} Result;
+
+typedef struct {
+  Range ranges[NUM_PARAMS];
+  long steps;
+  int batch;
+  const long *pending; // grid indices still to run
+  long num_pending;
+  _Atomic long next_batch;
+  pthread_mutex_t lock; // guards out, rows_written and write_failed
+  FILE *out;
+  long rows_written;
+  int write_failed;
+} Sweep;
+
+static atomic_int stop_requested;
+
+static void request_stop(int sig) {
+  (void)sig;
+  atomic_store(&stop_requested, 1);
+}
+
+static double wall_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double range_value(const Range *r, int i) {
+  return r->count > 1 ? r->min + (r->max - r->min) * i / (r->count - 1)
+                      : r->min;
+}
+
+// Grid point index, decoded with the last parameter varying fastest
+static O4mParams grid_point(const Range *ranges, long index) {
+  double v[NUM_PARAMS];
+  for (int k = NUM_PARAMS - 1; k >= 0; k--) {
+    v[k] = range_value(&ranges[k], (int)(index % ranges[k].count));
+    index /= ranges[k].count;
+  }
+  return (O4mParams){v[0], v[1], v[2], v[3]};
+}
+
+static void run_point(HcShape *hex, const O4mParams *p, long steps,
+                      Result *result) {
+  HcPolicy policy = o4m_policy(p);
+  Vec2 c = hex->center;
+  HcBall ball = {c.x, c.y, 0.0, 0.0};
+  double dt = 1.0 / FRAME_RATE;
+  double angle = 0.0;
+  double rest_since = -1;
+  double rest_speed = REST_SPEED + p->gravity * dt;
+
+  hex->omega = p->omega;
+  *result = (Result){-1, 0, 0};
+  for (long s = 0; s < steps; s++) {
+    result->contacts += o4m_step(&policy, hex, &ball, angle, dt);
+    angle += p->omega * dt;
+
+    double speed = hypot(ball.vx, ball.vy);
+    if (speed > result->max_speed)
+      result->max_speed = speed;
+
+    // Velocity of the hexagon's rigid rotation at the ball's centre
+    double wx = -p->omega * (ball.y - c.y), wy = p->omega * (ball.x - c.x);
+    double t = (s + 1) * dt;
+    if (hypot(ball.vx - wx, ball.vy - wy) > rest_speed)
+      rest_since = -1;
+    else if (rest_since < 0)
+      rest_since = t;
+    if (result->time_to_rest < 0 && rest_since >= 0 &&
+        t - rest_since >= REST_HOLD)
+      result->time_to_rest = rest_since;
+  }
+}
+
+static int format_row(char *buf, long index, const O4mParams *p,
+                      const Result *r) {
+  return snprintf(buf, ROW_MAX, "%ld,%.9g,%.9g,%.9g,%.9g,%.4f,%ld,%.3f\n",
+                  index, p->gravity, p->restitution, p->friction, p->omega,
+                  r->time_to_rest, r->contacts, r->max_speed);
+}
+
+static void *worker_main(void *arg) {
+  Sweep *sw = arg;
+  char *rows = malloc((size_t)sw->batch * ROW_MAX);
+  HcShape hex;
+  if (!rows || !hc_shape_init(&hex, 6, (Vec2){HEX_RADIUS, HEX_RADIUS},
+                              HEX_RADIUS, 0.0)) {
+    free(rows);
+    fprintf(stderr, "Cannot allocate worker\n");
+    pthread_mutex_lock(&sw->lock);
+    sw->write_failed = 1;
+    pthread_mutex_unlock(&sw->lock);
+    atomic_store(&stop_requested, 1);
+    return NULL;
+  }
+
+  while (!atomic_load(&stop_requested)) {
+    long first = atomic_fetch_add(&sw->next_batch, 1) * sw->batch;
+    if (first >= sw->num_pending)
+      break;
+    long last = first + sw->batch;
+    if (last > sw->num_pending)
+      last = sw->num_pending;
+
+    size_t len = 0;
+    for (long i = first; i < last; i++) {
+      long index = sw->pending[i];
+      O4mParams p = grid_point(sw->ranges, index);
+      Result r;
+      run_point(&hex, &p, sw->steps, &r);
+      len += format_row(rows + len, index, &p, &r);
+    }
+
+    // One write per batch, flushed, so an interruption loses at most the
+    // batches in flight and leaves at most one torn row at the end
+    pthread_mutex_lock(&sw->lock);
+    if (fwrite(rows, 1, len, sw->out) != len || fflush(sw->out) != 0) {
+      sw->write_failed = 1;
+      atomic_store(&stop_requested, 1);
+    } else {
+      sw->rows_written += last - first;
+    }
+    pthread_mutex_unlock(&sw->lock);
+  }
+
+  hc_shape_free(&hex);
+  free(rows);
+  return NULL;
+}
+
+static const char *const param_names[NUM_PARAMS] = {
+    "gravity", "restitution", "friction", "omega"};
+
+// NAME=MIN:MAX:COUNT or NAME=VALUE into the matching range
+static int parse_range(const char *arg, Range *ranges, int *given) {
+  const char *eq = strchr(arg, '=');
+  if (!eq)
+    return 0;
+  int k = 0;
+  while (k < NUM_PARAMS && (strlen(param_names[k]) != (size_t)(eq - arg) ||
+                            strncmp(arg, param_names[k], eq - arg) != 0))
+    k++;
+  if (k == NUM_PARAMS || given[k])
+    return 0;
+
+  Range *r = &ranges[k];
+  int end = 0;
+  if (sscanf(eq + 1, "%lf:%lf:%d%n", &r->min, &r->max, &r->count, &end) == 3 &&
+      eq[1 + end] == '\0' && r->count >= 1) {
+    given[k] = 1;
+    return 1;
+  }
+  end = 0;
+  if (sscanf(eq + 1, "%lf%n", &r->min, &end) == 1 && eq[1 + end] == '\0') {
+    r->max = r->min;
+    r->count = 1;
+    given[k] = 1;
+    return 1;
+  }
+  return 0;
+}
+
+// First line of the results file; a resumed run must match it exactly
+static void describe_sweep(const Sweep *sw, double duration, char *buf,
+                           size_t size) {
+  int n = snprintf(buf, size, "# sweep");
+  for (int k = 0; k < NUM_PARAMS; k++) {
+    const Range *r = &sw->ranges[k];
+    n += snprintf(buf + n, size - n, " %s=%.17g:%.17g:%d", r->name, r->min,
+                  r->max, r->count);
+  }
+  snprintf(buf + n, size - n, " duration=%.17g\n", duration);
+}
+
+static const char csv_header[] = "index,gravity,restitution,friction,omega,"
+                                 "time_to_rest,contacts,max_speed\n";
+
+// Marks the rows already in an earlier run's results file as done and cuts
+// the file back to its last complete row. Returns 1 if the file holds this
+// sweep, 0 if it does not exist or is empty, -1 on a mismatch or error.
+static int load_checkpoint(const char *path, const char *description,
+                           long total, unsigned char *done, long *num_done) {
+  FILE *in = fopen(path, "r");
+  if (!in) {
+    if (errno == ENOENT)
+      return 0;
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  char line[LINE_MAX_LEN];
+  long keep = 0; // bytes up to the end of the last complete line
+  int status = 1;
+  *num_done = 0;
+  if (!fgets(line, sizeof(line), in)) {
+    status = 0;
+  } else if (strcmp(line, description) != 0) {
+    fprintf(stderr, "%s: holds a different sweep:\n  %s", path, line);
+    status = -1;
+  } else if (!fgets(line, sizeof(line), in) || strcmp(line, csv_header)) {
+    // Killed before the header got out; start over
+    status = 0;
+  } else {
+    keep = ftell(in);
+    while (fgets(line, sizeof(line), in)) {
+      size_t len = strlen(line);
+      char *end;
+      long index = strtol(line, &end, 10);
+      if (len == 0 || line[len - 1] != '\n' || *end != ',' || index < 0 ||
+          index >= total)
+        break;
+      if (!done[index]) {
+        done[index] = 1;
+        (*num_done)++;
+      }
+      keep += len;
+    }
+  }
+  fclose(in);
+
+  if (status == 1 && truncate(path, keep) != 0) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  return status;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s [-d seconds] [-t threads] [-b batch] -o results.csv "
+          "NAME=MIN:MAX:COUNT...\n"
+          "  NAME  gravity, restitution, friction or omega; NAME=VALUE fixes "
+          "one\n"
+          "  -d S  simulated seconds per grid point (default: %.0f)\n"
+          "  -t N  worker threads (default: one per online CPU)\n"
+          "  -b N  grid points per batch written (default: %d)\n"
+          "  -o F  results file; rerunning resumes from the rows in it\n",
+          prog, DEFAULT_DURATION, DEFAULT_BATCH);
+}
+
+int main(int argc, char **argv) {
+  double duration = DEFAULT_DURATION;
+  int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int batch = DEFAULT_BATCH;
+  const char *out_path = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:t:b:o:h")) != -1) {
+    switch (opt) {
+    case 'd':
+      duration = atof(optarg);
+      break;
+    case 't':
+      num_workers = atoi(optarg);
+      break;
+    case 'b':
+      batch = atoi(optarg);
+      break;
+    case 'o':
+      out_path = optarg;
+      break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (duration <= 0 || num_workers < 1 || batch < 1 || !out_path) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  static Sweep sw;
+  double defaults[NUM_PARAMS] = {o4m_defaults.gravity,
+                                 o4m_defaults.restitution,
+                                 o4m_defaults.friction, o4m_defaults.omega};
+  int given[NUM_PARAMS] = {0};
+  for (int k = 0; k < NUM_PARAMS; k++)
+    sw.ranges[k] = (Range){param_names[k], defaults[k], defaults[k], 1};
+  for (int i = optind; i < argc; i++) {
+    if (!parse_range(argv[i], sw.ranges, given)) {
+      fprintf(stderr, "Bad or repeated range: %s\n", argv[i]);
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  long total = 1;
+  for (int k = 0; k < NUM_PARAMS; k++) {
+    if (total > MAX_POINTS / sw.ranges[k].count) {
+      fprintf(stderr, "More than %ld grid points\n", MAX_POINTS);
+      return 1;
+    }
+    total *= sw.ranges[k].count;
+  }
+
+  char description[LINE_MAX_LEN];
+  describe_sweep(&sw, duration, description, sizeof(description));
+  unsigned char *done = calloc(total, 1);
+  long *pending = malloc(total * sizeof(long));
+  if (!done || !pending) {
+    fprintf(stderr, "Cannot allocate %ld grid points\n", total);
+    return 1;
+  }
+
+  long num_done = 0;
+  int resumed = load_checkpoint(out_path, description, total, done, &num_done);
+  if (resumed < 0)
+    return 1;
+  sw.out = fopen(out_path, resumed ? "a" : "w");
+  if (!sw.out) {
+    fprintf(stderr, "%s: %s\n", out_path, strerror(errno));
+    return 1;
+  }
+  if (!resumed) {
+    fputs(description, sw.out);
+    fputs(csv_header, sw.out);
+    fflush(sw.out);
+  }
+
+  for (long i = 0; i < total; i++)
+    if (!done[i])
+      pending[sw.num_pending++] = i;
+  sw.pending = pending;
+  sw.steps = (long)(duration * FRAME_RATE + 0.5);
+  sw.batch = batch;
+  atomic_init(&sw.next_batch, 0);
+  pthread_mutex_init(&sw.lock, NULL);
+  if (num_done)
+    fprintf(stderr, "resuming: %ld of %ld grid points already done\n",
+            num_done, total);
+
+  // Let a Ctrl-C finish the batches in flight so they reach the file
+  struct sigaction sa = {0};
+  sa.sa_handler = request_stop;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  pthread_t *threads = malloc(num_workers * sizeof(pthread_t));
+  if (!threads) {
+    fprintf(stderr, "Cannot allocate %d workers\n", num_workers);
+    return 1;
+  }
+  double start = wall_now();
+  int started = 0;
+  for (; started < num_workers; started++) {
+    int err = pthread_create(&threads[started], NULL, worker_main, &sw);
+    if (err) {
+      fprintf(stderr, "pthread_create: %s\n", strerror(err));
+      break;
+    }
+  }
+  for (int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+  double elapsed = wall_now() - start;
+
+  int failed = sw.write_failed || started == 0;
+  if (fclose(sw.out) != 0 || sw.write_failed) {
+    fprintf(stderr, "%s: write failed\n", out_path);
+    failed = 1;
+  }
+
+  long remaining = sw.num_pending - sw.rows_written;
+  fprintf(stderr, "%ld grid points in %.2f s on %d threads (%.1f per second)\n",
+          sw.rows_written, elapsed, started,
+          elapsed > 0 ? sw.rows_written / elapsed : 0.0);
+  if (remaining > 0)
+    fprintf(stderr, "stopped with %ld of %ld left; run again to resume\n",
+            remaining, total);
+
+  pthread_mutex_destroy(&sw.lock);
+  free(threads);
+  free(pending);
+  free(done);
+  return failed || remaining > 0;
+}